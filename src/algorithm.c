@@ -27,15 +27,17 @@
 struct algorithm {
 	const char *name;
 	alg_ptr ptr;
+	batch_alg_ptr batch;
 };
 
 static struct algorithm algs[] = {
-	{ "gmd",    pc_decode_gmd     },
-	{ "gd",	    pc_decode_gd      },
-	{ "iter",   pc_decode_iter    },
-	{ "eras",   pc_decode_eras    },
-	{ "itergd", pc_decode_iter_gd },
-	{ "erasgd", pc_decode_eras_gd }
+	{ "gmd",    pc_decode_gmd,     NULL		    },
+	{ "gd",	    pc_decode_gd,      NULL		    },
+	{ "iter",   pc_decode_iter,    pc_decode_iter_batch },
+	{ "eras",   pc_decode_eras,    pc_decode_eras_batch },
+	{ "itergd", pc_decode_iter_gd, NULL		    },
+	{ "erasgd", pc_decode_eras_gd, NULL		    },
+	{ "auto",   pc_decode_auto,    NULL		    }
 };
 
 alg_ptr algorithm_by_name(const char *name)
@@ -56,6 +58,20 @@ const char *algorithm_get_name(alg_ptr alg)
 	return NULL;
 }
 
+batch_alg_ptr algorithm_get_batch(alg_ptr alg)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(algs); i++)
+		if (alg == algs[i].ptr)
+			return algs[i].batch;
+
+	return NULL;
+}
+
+alg_ptr algorithm_by_index(size_t i)
+{
+	return i < ARRAY_SIZE(algs) ? algs[i].ptr : NULL;
+}
+
 int algorithm_print_names(FILE *file)
 {
 	libcheck(fprintf(file, "Available algorithms are:\n") > 0, "printing error");
@@ -25,6 +25,8 @@
 #include "product_code.h"
 
 typedef int (*alg_ptr)(struct pc *, uint16_t *, struct stats *);
+typedef size_t (*batch_alg_ptr)(struct pc_batch *, uint16_t *, int *,
+				struct stats *);
 
 /*
  * Returns a pointer to the decoding function of the specified algorithm.
@@ -35,6 +37,14 @@ alg_ptr algorithm_by_name(const char *name);
 /* Returns the name associated with the given decoding algorithm. */
 const char *algorithm_get_name(alg_ptr alg);
 
+/* Returns the batch version of the given decoding algorithm, or NULL if the
+ * algorithm has none. */
+batch_alg_ptr algorithm_get_batch(alg_ptr alg);
+
+/* Returns the i-th algorithm, in the order of algorithm_print_names, or NULL
+ * if there are no more. */
+alg_ptr algorithm_by_index(size_t i);
+
 /* Prints the names of all the available algorithms; one on each line */
 int algorithm_print_names(FILE *file);
 
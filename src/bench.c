@@ -0,0 +1,260 @@
+/*
+ * bench.c
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#include "dbg.h"
+#include "bench.h"
+#include "gen_errors.h"
+#include "algorithm.h"
+#include "rng.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+struct wspace {
+	uint16_t *c;    /* sent codeword */
+	uint16_t *r;    /* received words */
+	uint16_t *y;    /* word being decoded */
+};
+
+static struct wspace *alloc_ws(size_t len, size_t nwords)
+{
+	struct wspace *ws;
+
+	ws = calloc(1, sizeof(*ws));
+	if (!ws)
+		return NULL;
+
+	ws->c = malloc((nwords + 2) * len * sizeof(*ws->c));
+	if (!ws->c)
+		goto err;
+
+	ws->y = ws->c + len;
+	ws->r = ws->y + len;
+	return ws;
+
+err:
+	free(ws->c);
+	free(ws);
+	return NULL;
+}
+
+static void free_ws(struct wspace *ws)
+{
+	if (!ws)
+		return;
+
+	free(ws->c);
+	free(ws);
+}
+
+static double now(void)
+{
+	struct timespec tp;
+
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return tp.tv_sec + tp.tv_nsec * 1E-9;
+}
+
+static void print_start(FILE *file, const struct options *opt,
+			const char *prefix, const char *alg)
+{
+	static const char *const layout_heads[] = {
+		"rows and columns",
+		"number of codewords",
+		"strided layout, microseconds per codeword",
+		"transposed layout, microseconds per codeword",
+		"speedup of the transposed layout",
+	};
+	static const char *const encode_heads[] = {
+		"rows and columns",
+		"number of codewords",
+		"librs, microseconds per codeword",
+		"pc_encode, microseconds per codeword",
+		"speedup of pc_encode",
+	};
+	const char *const *col_heads = opt->encode ? encode_heads : layout_heads;
+
+	fprintf(file, "%sSymbol size: %zu\n", prefix, opt->symsize);
+	fprintf(file, "%sRow code nroots: %zu\n", prefix, opt->r_nroots);
+	fprintf(file, "%sCol code nroots: %zu\n", prefix, opt->c_nroots);
+	fprintf(file, "%sChannel error probability: %f\n", prefix, opt->p);
+	fprintf(file, "%sAlgorithm: %s\n", prefix, alg);
+	fprintf(file, "%sSeed: %lu\n", prefix, opt->seed);
+	for (size_t i = 0; i < ARRAY_SIZE(layout_heads); i++)
+		fprintf(file, "%s(%zu) %s\n", prefix, i + 1, col_heads[i]);
+}
+
+/* Returns the average decoding time in microseconds */
+static double time_decode(struct options *opt, struct pc *pc,
+			  struct wspace *ws, enum pc_layout layout)
+{
+	size_t len = pc_len(pc);
+	struct stats s;
+
+	if (pc_set_layout(pc, layout))
+		return -1;
+
+	/* One untimed decode to warm up the caches */
+	memcpy(ws->y, ws->r, len * sizeof(*ws->y));
+	opt->alg(pc, ws->y, &s);
+
+	double start = now();
+	for (size_t j = 0; j < opt->cword_num; j++) {
+		memcpy(ws->y, ws->r + j * len, len * sizeof(*ws->y));
+		opt->alg(pc, ws->y, &s);
+	}
+
+	return (now() - start) * 1E6 / opt->cword_num;
+}
+
+/* Compares the column pass layouts on n x n codes */
+static int bench_layout(struct options *opt, gsl_rng *rng, size_t n)
+{
+	struct wspace *ws = NULL;
+	struct pc *pc = pc_init(opt->symsize, opt->gfpoly, opt->r_fcr,
+				opt->r_prim, opt->r_nroots, opt->c_fcr,
+				opt->c_prim, opt->c_nroots, n, n);
+	check(pc, "could not initialize a %zux%zu product code", n, n);
+
+	size_t len = pc_len(pc);
+	ws = alloc_ws(len, opt->cword_num);
+	check_mem(ws);
+
+	for (size_t j = 0; j < opt->cword_num; j++)
+		get_rcw_channel(pc, ws->c, ws->r + j * len, opt->p, rng);
+
+	double strided = time_decode(opt, pc, ws, PC_LAYOUT_STRIDED);
+	double transposed = time_decode(opt, pc, ws, PC_LAYOUT_TRANSPOSED);
+	check(strided >= 0 && transposed >= 0, "Memory allocation error");
+
+	printf("%zu %zu %f %f %f\n", n, opt->cword_num,
+	       strided, transposed, strided / transposed);
+	fflush(stdout);
+
+	free_ws(ws);
+	pc_free(pc);
+	return 0;
+
+error:
+	free_ws(ws);
+	pc_free(pc);
+	return -1;
+}
+
+/* Encodes with one rs_encode call per column and row */
+static void encode_librs(struct pc *pc, uint16_t *data)
+{
+	size_t row_dlen = pc->cols - pc->row_code->nroots;
+	for (size_t i = 0; i < row_dlen; i++)
+		rs_encode(pc->col_code, &data[i], pc->rows, pc->cols);
+
+	uint16_t *end = data + pc_len(pc);
+	for (uint16_t *ptr = data; ptr < end; ptr += pc->cols)
+		rs_encode(pc->row_code, ptr, pc->cols, 1);
+}
+
+/* Returns the average encoding time in microseconds */
+static double time_encode(struct options *opt, struct pc *pc,
+			  struct wspace *ws,
+			  void (*encode)(struct pc *, uint16_t *))
+{
+	size_t len = pc_len(pc);
+
+	/* One untimed encode to warm up the caches */
+	memcpy(ws->y, ws->r, len * sizeof(*ws->y));
+	encode(pc, ws->y);
+
+	double start = now();
+	for (size_t j = 0; j < opt->cword_num; j++)
+		encode(pc, ws->r + j * len);
+
+	return (now() - start) * 1E6 / opt->cword_num;
+}
+
+/* Compares pc_encode to encoding with librs on n x n codes */
+static int bench_encode(struct options *opt, gsl_rng *rng, size_t n)
+{
+	struct wspace *ws = NULL;
+	struct pc *pc = pc_init(opt->symsize, opt->gfpoly, opt->r_fcr,
+				opt->r_prim, opt->r_nroots, opt->c_fcr,
+				opt->c_prim, opt->c_nroots, n, n);
+	check(pc, "could not initialize a %zux%zu product code", n, n);
+
+	size_t len = pc_len(pc);
+	int nn = pc->row_code->nn;
+	ws = alloc_ws(len, opt->cword_num);
+	check_mem(ws);
+
+	for (size_t i = 0; i < opt->cword_num * len; i++)
+		ws->r[i] = gsl_rng_get(rng) & nn;
+
+	/* Both encoders must give the same codeword */
+	memcpy(ws->c, ws->r, len * sizeof(*ws->c));
+	memcpy(ws->y, ws->r, len * sizeof(*ws->y));
+	encode_librs(pc, ws->c);
+	pc_encode(pc, ws->y);
+	check(!memcmp(ws->c, ws->y, len * sizeof(*ws->c)),
+	      "pc_encode and librs disagree on a %zux%zu code", n, n);
+
+	double librs = time_encode(opt, pc, ws, encode_librs);
+	double vec = time_encode(opt, pc, ws, pc_encode);
+
+	printf("%zu %zu %f %f %f\n", n, opt->cword_num, librs, vec,
+	       librs / vec);
+	fflush(stdout);
+
+	free_ws(ws);
+	pc_free(pc);
+	return 0;
+
+error:
+	free_ws(ws);
+	pc_free(pc);
+	return -1;
+}
+
+int run_bench(struct options *opt)
+{
+	size_t nn = (1 << opt->symsize) - 1;
+	size_t max_size = opt->max_size < nn ? opt->max_size : nn;
+
+	gsl_rng *rng = rng_alloc_and_seed(opt->rng_type, opt->seed);
+	if (!rng)
+		return -1;
+
+	print_start(stdout, opt, "# ", algorithm_get_name(opt->alg));
+
+	int (*bench)(struct options *, gsl_rng *, size_t) =
+		opt->encode ? bench_encode : bench_layout;
+
+	int ret = 0;
+	for (size_t n = opt->min_size; n <= max_size && !ret; n *= 2) {
+		ret = bench(opt, rng, n);
+		if (n < max_size && 2 * n > max_size)
+			ret = bench(opt, rng, max_size);
+	}
+
+	gsl_rng_free(rng);
+	return ret;
+}
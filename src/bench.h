@@ -0,0 +1,69 @@
+/*
+ * bench.h
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#ifndef FB_PCDECODE_BENCH_H
+#define FB_PCDECODE_BENCH_H
+
+#include "product_code.h"
+#include "rng.h"
+
+struct options {
+	const gsl_rng_type *rng_type;
+	int (*alg)(struct pc *, uint16_t *, struct stats *);
+	size_t cword_num;
+	unsigned long seed;
+	double p;
+	size_t min_size;
+	size_t max_size;
+	int encode;
+
+	/* The suite and the comparison of its results */
+	int suite;
+	size_t reps;
+	size_t warmup;
+	double min_time;	/* seconds per repetition, at least */
+	const char *filter;
+	const char *old_file;
+	const char *new_file;
+	double threshold;	/* percent */
+
+	size_t symsize;
+	size_t gfpoly;
+	size_t r_fcr;
+	size_t r_prim;
+	size_t r_nroots;
+	size_t c_fcr;
+	size_t c_prim;
+	size_t c_nroots;
+};
+
+
+int run_bench(struct options *opt);
+
+/* Runs the benchmark suite on the canonical code shapes and writes the
+ * results to stdout as JSON, one result per line */
+int run_bench_suite(struct options *opt);
+
+/* Compares the results of two runs of the suite. Returns the number of
+ * benchmarks that got slower, or -1 on errors. */
+int run_bench_compare(struct options *opt);
+
+#endif /* FB_PCDECODE_BENCH_H */
@@ -0,0 +1,210 @@
+/*
+ * bench_compare.c
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#include "dbg.h"
+#include "bench.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+struct result {
+	char name[64];
+	char shape[32];
+	double median;
+	double mad;
+	int seen;
+};
+
+struct results {
+	struct result *r;
+	size_t n;
+};
+
+/* Copies the string value of key in the JSON object on line to buf */
+static int get_str(const char *line, const char *key, char *buf, size_t size)
+{
+	char pat[32];
+
+	snprintf(pat, sizeof(pat), "\"%s\": \"", key);
+	const char *p = strstr(line, pat);
+	if (!p)
+		return -1;
+
+	p += strlen(pat);
+	const char *end = strchr(p, '"');
+	if (!end || (size_t) (end - p) >= size)
+		return -1;
+
+	memcpy(buf, p, end - p);
+	buf[end - p] = '\0';
+	return 0;
+}
+
+static int get_num(const char *line, const char *key, double *x)
+{
+	char pat[32];
+
+	snprintf(pat, sizeof(pat), "\"%s\": ", key);
+	const char *p = strstr(line, pat);
+	if (!p)
+		return -1;
+
+	char *end;
+	*x = strtod(p + strlen(pat), &end);
+	return end == p + strlen(pat) ? -1 : 0;
+}
+
+/* Reads the results from a file written by run_bench_suite, which has one
+ * result per line */
+static int load(const char *path, struct results *res)
+{
+	char *line = NULL;
+	size_t size = 0, alloc = 0;
+
+	res->r = NULL;
+	res->n = 0;
+
+	FILE *file = fopen(path, "r");
+	check(file, "cannot open '%s'", path);
+
+	while (getline(&line, &size, file) != -1) {
+		struct result r = { .seen = 0 };
+
+		if (!strstr(line, "\"name\": "))
+			continue;
+
+		check(!get_str(line, "name", r.name, sizeof(r.name))
+		      && !get_str(line, "shape", r.shape, sizeof(r.shape))
+		      && !get_num(line, "median_ns", &r.median)
+		      && !get_num(line, "mad_ns", &r.mad),
+		      "malformed result in '%s': %s", path, line);
+
+		if (res->n == alloc) {
+			alloc = alloc ? 2 * alloc : 64;
+			struct result *tmp = realloc(res->r,
+						     alloc * sizeof(*tmp));
+			check_mem(tmp);
+			res->r = tmp;
+		}
+		res->r[res->n++] = r;
+	}
+
+	check(!ferror(file), "cannot read '%s'", path);
+	free(line);
+	fclose(file);
+	return 0;
+
+error:
+	free(line);
+	if (file)
+		fclose(file);
+	free(res->r);
+	res->r = NULL;
+	return -1;
+}
+
+static struct result *find(struct results *res, const struct result *r)
+{
+	for (size_t i = 0; i < res->n; i++)
+		if (!strcmp(res->r[i].name, r->name) &&
+		    !strcmp(res->r[i].shape, r->shape))
+			return &res->r[i];
+
+	return NULL;
+}
+
+/*
+ * A result is slower or faster if its median changed by more than the
+ * threshold, and by more than the sum of the median absolute deviations of
+ * the two runs, so that noisy results are not flagged.
+ */
+static const char *verdict(const struct result *o, const struct result *n,
+			   double threshold)
+{
+	double diff = n->median - o->median;
+
+	if (fabs(diff) <= o->mad + n->mad)
+		return "same";
+	if (diff > o->median * threshold / 100)
+		return "slower";
+	if (-diff > o->median * threshold / 100)
+		return "faster";
+
+	return "same";
+}
+
+int run_bench_compare(struct options *opt)
+{
+	static const char *const col_heads[] = {
+		"benchmark",
+		"code shape",
+		"old median, nanoseconds",
+		"new median, nanoseconds",
+		"change in percent",
+		"verdict",
+	};
+	struct results old, new;
+	int nslower = 0;
+
+	if (load(opt->old_file, &old))
+		return -1;
+	if (load(opt->new_file, &new)) {
+		free(old.r);
+		return -1;
+	}
+
+	printf("# Old: %s\n# New: %s\n# Threshold: %g%%\n", opt->old_file,
+	       opt->new_file, opt->threshold);
+	for (size_t i = 0; i < sizeof(col_heads) / sizeof(col_heads[0]); i++)
+		printf("# (%zu) %s\n", i + 1, col_heads[i]);
+
+	for (size_t i = 0; i < new.n; i++) {
+		struct result *n = &new.r[i];
+		struct result *o = find(&old, n);
+
+		if (!o) {
+			printf("%s %s nan %.1f nan added\n", n->name, n->shape,
+			       n->median);
+			continue;
+		}
+
+		o->seen = 1;
+		const char *v = verdict(o, n, opt->threshold);
+		if (!strcmp(v, "slower"))
+			nslower++;
+
+		printf("%s %s %.1f %.1f %+.1f %s\n", n->name, n->shape,
+		       o->median, n->median,
+		       (n->median - o->median) / o->median * 100, v);
+	}
+
+	for (size_t i = 0; i < old.n; i++) {
+		struct result *o = &old.r[i];
+		if (!o->seen)
+			printf("%s %s %.1f nan nan removed\n", o->name,
+			       o->shape, o->median);
+	}
+
+	free(old.r);
+	free(new.r);
+	return nslower;
+}
@@ -0,0 +1,328 @@
+/*
+ * Benchmarks for the product code decoders.
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#include "dbg.h"
+#include "version.h"
+#include "rng.h"
+#include "bench.h"
+#include "algorithm.h"
+#include <getopt.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <math.h>
+
+static int print_help(FILE *file)
+{
+	static const char *formatstr =
+		"Usage: %s [OPTION]...\n"
+		"  or:  %s --suite [OPTION]...\n"
+		"  or:  %s --compare [OPTION]... OLD NEW\n\n%s\n";
+	static const char *helpstr =
+"Benchmark the column pass layouts of the product code decoders. Square\n"
+"product codes of increasing size are decoded with both the strided and the\n"
+"transposed layout, which shows the size where the transposed layout starts\n"
+"to pay off. With --encode the encoder is benchmarked against encoding with\n"
+"librs instead. Outputs to stdout.\n\n"
+"With --suite, rs_decode and rsdec_decode at several error weights,\n"
+"pc_encode, the channel and every decoding algorithm on fixed error patterns\n"
+"are timed on a canonical set of code shapes, and the results are written as\n"
+"JSON. Each benchmark is repeated and the median, the median absolute\n"
+"deviation, the minimum and the mean of the time per operation are reported.\n"
+"The decoding times include copying the word, which decode/copy times on its\n"
+"own. With --compare, two such files are compared, and benchmarks whose median\n"
+"changed by more than the threshold, and by more than the noise, are flagged.\n\n"
+"Mandatory arguments to long options are mandatory for short options too.\n"
+"  -a, --algorithm=ALG		The decoding algorithm to use. To see a list of all\n"
+"                                 available algorithms give 'list' as argument.\n"
+"  -m, --min-size=NUM           The number of rows and columns of the smallest\n"
+"                                 code. The size is doubled until it reaches\n"
+"                                 the maximum size.\n"
+"  -M, --max-size=NUM           The number of rows and columns of the largest\n"
+"                                 code.\n"
+"      --c-nroots=NUM           The number of roots in the column code.\n"
+"      --r-nroots=NUM           The number of roots in the row code.\n"
+"  -e, --encode                 Benchmark the encoder instead of a decoder.\n"
+"      --compare                Compare the results OLD and NEW of two runs of\n"
+"                                 the suite. The exit status is 1 if some\n"
+"                                 benchmark got slower and 2 if the files\n"
+"                                 cannot be read.\n"
+"      --filter=STR             Only run the benchmarks of the suite whose\n"
+"                                 names contain STR.\n"
+"  -g, --gfpoly=POLY            The Galois Field polynomial to use. If POLY is zero,\n"
+"                                 then the default polynomial is used.\n"
+"  -n, --num-words=NUM          The number of words to decode per size.\n"
+"  -p, --p=VAL                  The channel error probability.\n"
+"      --min-time=MS            The least time a repetition of a benchmark in\n"
+"                                 the suite takes. The default is 20.\n"
+"      --reps=NUM               The number of timed repetitions of each\n"
+"                                 benchmark in the suite. The default is 11.\n"
+"  -R, --rng=RNG                The random number generator to use. To see a list of all\n"
+"                                 available generators give 'list' as argument.\n"
+"  -s, --sym-size=NUM           The symbol size in bits.\n"
+"  -S, --seed=SEED              The seed for the random number generator. The\n"
+"                                 suite uses 1 by default, so that the error\n"
+"                                 patterns are the same in every run.\n"
+"      --suite                  Run the benchmark suite.\n"
+"      --threshold=PCT          The change in percent that --compare flags.\n"
+"                                 The default is 5.\n"
+"      --warmup=NUM             The number of untimed repetitions before the\n"
+"                                 timed ones. The default is 2.\n"
+"      --help                   Display this help and exit.\n"
+"      --version                Output version information and exit.\n";
+
+	return (fprintf(file, formatstr, PROGRAM_NAME, PROGRAM_NAME,
+			PROGRAM_NAME, helpstr) < 0)
+	       ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static void parse_cmdline(int argc, char *const argv[], struct options *opt)
+{
+	static const char *optstring = "a:eg:n:m:M:p:R:S:s:";
+	static struct option longopt[] = {
+		{ "algorithm", required_argument, NULL, 'a' },
+		{ "encode",    no_argument,	  NULL, 'e' },
+		{ "compare",   no_argument,	  NULL, 'C' },
+		{ "filter",    required_argument, NULL, 'F' },
+		{ "min-time",  required_argument, NULL, 'I' },
+		{ "reps",      required_argument, NULL, 'N' },
+		{ "suite",     no_argument,	  NULL, 'B' },
+		{ "threshold", required_argument, NULL, 'L' },
+		{ "warmup",    required_argument, NULL, 'W' },
+		{ "gfpoly",    required_argument, NULL, 'g' },
+		{ "num-words", required_argument, NULL, 'n' },
+		{ "min-size",  required_argument, NULL, 'm' },
+		{ "max-size",  required_argument, NULL, 'M' },
+		{ "p",	       required_argument, NULL, 'p' },
+		{ "r-nroots",  required_argument, NULL, 'U' },
+		{ "c-nroots",  required_argument, NULL, 'u' },
+		{ "rng",       required_argument, NULL, 'R' },
+		{ "seed",      required_argument, NULL, 'S' },
+		{ "sym-size",  required_argument, NULL, 's' },
+		{ "help",      no_argument,	  NULL, 'h' },
+		{ "version",   no_argument,	  NULL, 'V' },
+		{ 0,	       0,		  0,	0   }
+	};
+
+	// Setting default options
+	*opt = (struct options) {
+		.alg = pc_decode_iter,
+		.symsize = 0, .gfpoly = 0,
+		.min_size = 64, .max_size = 1023, .encode = 0,
+		.r_nroots = 0, .c_nroots = 0,
+		.r_fcr = 1, .c_fcr = 1,
+		.r_prim = 1, .c_prim = 1,
+		.cword_num = 10, .seed = 0,
+		.p = 0.001,
+		.reps = 11, .warmup = 2, .min_time = 0.02,
+		.threshold = 5,
+		.rng_type = gsl_rng_default
+	};
+
+	// Parsing the command line
+	int ch, compare = 0;
+	char *endptr;
+	while ((ch = getopt_long(argc, argv, optstring, longopt, NULL)) != -1) {
+		switch (ch) {
+		case 'a':
+		{
+			if (!strcmp(optarg, "list")) {
+				exit(algorithm_print_names(stdout));
+			} else {
+				opt->alg = algorithm_by_name(optarg);
+				check(opt->alg, "invalid argument to option "
+				      "'%c': '%s'", ch, optarg);
+			}
+			break;
+		}
+		case 'e':
+			opt->encode = 1;
+			break;
+		case 'B':
+			opt->suite = 1;
+			break;
+		case 'C':
+			compare = 1;
+			break;
+		case 'F':
+			opt->filter = optarg;
+			break;
+		case 'I':
+			opt->min_time = strtod(optarg, &endptr) / 1000;
+			check(*endptr == '\0' && opt->min_time >= 0
+			      && errno != ERANGE,
+			      "invalid argument to option '%s': '%s'",
+			      "min-time", optarg);
+			break;
+		case 'L':
+			opt->threshold = strtod(optarg, &endptr);
+			check(*endptr == '\0' && opt->threshold >= 0
+			      && errno != ERANGE,
+			      "invalid argument to option '%s': '%s'",
+			      "threshold", optarg);
+			break;
+		case 'N':
+			opt->reps = strtoul(optarg, &endptr, 10);
+			check(*endptr == '\0' && opt->reps > 0
+			      && !(errno == ERANGE && opt->reps == ULONG_MAX),
+			      "invalid argument to option '%s': '%s'",
+			      "reps", optarg);
+			break;
+		case 'W':
+			opt->warmup = strtoul(optarg, &endptr, 10);
+			check(*endptr == '\0'
+			      && !(errno == ERANGE && opt->warmup == ULONG_MAX),
+			      "invalid argument to option '%s': '%s'",
+			      "warmup", optarg);
+			break;
+		case 'g':
+			opt->gfpoly = strtoul(optarg, &endptr, 0);
+			check(*endptr == '\0'
+			      && !(errno == ERANGE && opt->gfpoly == ULONG_MAX),
+			      "invalid argument to option '%c': '%s'", ch, optarg);
+			break;
+		case 'n':
+			opt->cword_num = strtoul(optarg, &endptr, 10);
+			check(*endptr == '\0' && opt->cword_num > 0
+			      && !(errno == ERANGE && opt->cword_num == ULONG_MAX),
+			      "invalid argument to option '%c': '%s'", ch, optarg);
+			break;
+		case 'm':
+			opt->min_size = strtoul(optarg, &endptr, 10);
+			check(*endptr == '\0' && opt->min_size > 0
+			      && !(errno == ERANGE && opt->min_size == ULONG_MAX),
+			      "invalid argument to option '%c': '%s'", ch, optarg);
+			break;
+		case 'M':
+			opt->max_size = strtoul(optarg, &endptr, 10);
+			check(*endptr == '\0'
+			      && !(errno == ERANGE && opt->max_size == ULONG_MAX),
+			      "invalid argument to option '%c': '%s'", ch, optarg);
+			break;
+		case 'p':
+			opt->p = strtod(optarg, &endptr);
+			check(*endptr == '\0' && opt->p >= 0 && opt->p <= 1
+			      && !(errno == ERANGE && opt->p == HUGE_VAL),
+			      "invalid argument to option '%c': '%s'", ch, optarg);
+			break;
+		case 'R':
+		{
+			const gsl_rng_type **rng_types = gsl_rng_types_setup();
+			if (!strcmp(optarg, "list")) {
+				exit(print_rngs(stdout, rng_types));
+			} else {
+				opt->rng_type = get_rng_type(optarg, rng_types);
+				check(opt->rng_type, "invalid random number generator");
+			}
+			break;
+		}
+		case 'S':
+			opt->seed = strtoul(optarg, &endptr, 10);
+			check(*endptr == '\0'
+			      && !(errno == ERANGE && opt->seed == ULONG_MAX),
+			      "invalid argument to option '%c': '%s'", ch, optarg);
+			break;
+		case 's':
+			opt->symsize = strtoul(optarg, &endptr, 10);
+			check(*endptr == '\0'
+			      && !(errno == ERANGE && opt->symsize == ULONG_MAX)
+			      && opt->symsize <= 16,
+			      "invalid argument to option '%c': '%s'", ch, optarg);
+			break;
+		case 'U':
+			opt->r_nroots = strtoul(optarg, &endptr, 10);
+			check(*endptr == '\0'
+			      && !(errno == ERANGE && opt->r_nroots == ULONG_MAX),
+			      "invalid argument to option '%c': '%s'", ch, optarg);
+			break;
+		case 'u':
+			opt->c_nroots = strtoul(optarg, &endptr, 10);
+			check(*endptr == '\0'
+			      && !(errno == ERANGE && opt->c_nroots == ULONG_MAX),
+			      "invalid argument to option '%c': '%s'", ch, optarg);
+			break;
+		case 'h':
+			exit(print_help(stdout));
+		case 'V':
+			exit(print_version(stdout));
+		default:
+			goto error;
+		}
+	}
+
+
+	if (compare) {
+		check(argc - optind == 2, "expected the files OLD and NEW");
+		check(!opt->suite, "the options '%s' and '%s' cannot be "
+		      "combined", "suite", "compare");
+		opt->old_file = argv[optind];
+		opt->new_file = argv[optind + 1];
+		return;
+	}
+
+	check(optind == argc, "unexpected argument '%s'", argv[optind]);
+	if (opt->suite)
+		return;
+
+	// Check for mandatory arguments.
+	check(opt->symsize > 0, "missing mandatory option -- '%c'", 's');
+	check(opt->r_nroots > 0, "missing mandatory option -- '%s'", "r-nroots");
+	check(opt->c_nroots > 0, "missing mandatory option -- '%s'", "c-nroots");
+
+	// Checking that arguments are sane
+	check(opt->min_size > opt->r_nroots && opt->min_size > opt->c_nroots,
+	      "min-size must be larger than the number of roots");
+
+	if (opt->gfpoly == 0)
+		opt->gfpoly = get_gfpoly(opt->symsize);
+
+	return;
+
+error:
+	fprintf(stderr, "Try '%s --help' for more information.\n", PROGRAM_NAME);
+	exit(EXIT_FAILURE);
+}
+
+
+int main(int argc, char *argv[])
+{
+	struct options opt;
+	PROGRAM_NAME = argv[0];
+
+	gsl_set_error_handler_off();
+	parse_cmdline(argc, argv, &opt);
+
+	if (opt.old_file) {
+		int ret = run_bench_compare(&opt);
+		return ret < 0 ? 2 : ret > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
+	if (opt.suite) {
+		opt.seed = opt.seed ? opt.seed : 1;
+		return run_bench_suite(&opt) ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
+	opt.seed = opt.seed ? opt.seed : get_random_seed();
+
+	return run_bench(&opt) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,389 @@
+/*
+ * bench_suite.c
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#include "dbg.h"
+#include "bench.h"
+#include "gen_errors.h"
+#include "algorithm.h"
+#include "version.h"
+#include "rng.h"
+#include "gf.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+/* The number of distinct words or rows that a benchmark cycles through */
+#define NPAT_WORDS 16
+#define NPAT_ROWS 256
+
+/*
+ * The canonical code shapes: from codes that fit in the L1 cache to codes
+ * that do not fit in L2, and symbol sizes both with and without the SIMD
+ * kernels.
+ */
+static const struct shape {
+	size_t symsize;
+	size_t rows;
+	size_t cols;
+	size_t r_nroots;
+	size_t c_nroots;
+} shapes[] = {
+	{ 4,  15,  15,  4,  4 },
+	{ 6,  40,  40,  6,  6 },
+	{ 8,  128, 128, 16, 16 },
+	{ 8,  255, 255, 32, 32 },
+	{ 10, 512, 512, 32, 32 },
+};
+
+/* What the benchmarks work on. Each benchmark does one operation on pattern
+ * i % npat of words, or of rows, per call. */
+struct bctx {
+	struct pc *pc;
+	alg_ptr alg;
+	gsl_rng *rng;
+	size_t len;		/* of a word */
+	uint16_t *c;		/* a codeword */
+	uint16_t *y;		/* the word operated on */
+	uint16_t *words;	/* NPAT_WORDS received words */
+	uint16_t *rows;		/* NPAT_ROWS received rows */
+	int *errlocs;
+	uint16_t *syn;
+	int *errpos;
+	uint16_t *errval;
+	double p;
+	int errs;
+	struct stats s;
+};
+
+struct bench {
+	const char *name;
+	void (*op)(struct bctx *b, size_t i);
+};
+
+static double now(void)
+{
+	struct timespec tp;
+
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return tp.tv_sec + tp.tv_nsec * 1E-9;
+}
+
+static void op_copy(struct bctx *b, size_t i)
+{
+	memcpy(b->y, b->words + i % NPAT_WORDS * b->len,
+	       b->len * sizeof(*b->y));
+}
+
+/* librs decodes in place, so the row is copied first */
+static void op_rs_decode(struct bctx *b, size_t i)
+{
+	size_t cols = b->pc->cols;
+
+	memcpy(b->y, b->rows + i % NPAT_ROWS * cols, cols * sizeof(*b->y));
+	rs_decode(b->pc->row_code, b->y, cols, 1, NULL, 0, NULL);
+}
+
+static void op_rsdec_decode(struct bctx *b, size_t i)
+{
+	const struct rsdec *rs = b->pc->row_dec;
+	size_t cols = b->pc->cols;
+
+	rsdec_syndrome(rs, b->rows + i % NPAT_ROWS * cols, cols, 1, b->syn);
+	if (!rsdec_syn_zero(rs, b->syn))
+		rsdec_decode(rs, b->syn, cols, NULL, 0, b->errpos, b->errval);
+}
+
+static void op_encode(struct bctx *b, size_t i)
+{
+	(void) i;
+	pc_encode(b->pc, b->y);
+}
+
+static void op_msg(struct bctx *b, size_t i)
+{
+	(void) i;
+	gen_random_msg(b->pc, b->y, b->rng);
+}
+
+static void op_channel(struct bctx *b, size_t i)
+{
+	(void) i;
+	add_channel_errors(b->pc, b->c, b->y, b->p, b->rng);
+}
+
+static void op_we(struct bctx *b, size_t i)
+{
+	(void) i;
+	get_rcw_we(b->pc, b->c, b->y, b->errs, b->errlocs, b->rng);
+}
+
+/* The copy of the word is included, as timed by decode/copy */
+static void op_decode(struct bctx *b, size_t i)
+{
+	op_copy(b, i);
+	b->alg(b->pc, b->y, &b->s);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+	return (x > y) - (x < y);
+}
+
+static double median(double *x, size_t n)
+{
+	qsort(x, n, sizeof(*x), cmp_double);
+	return n % 2 ? x[n / 2] : (x[n / 2 - 1] + x[n / 2]) / 2;
+}
+
+static double time_ops(const struct bench *bm, struct bctx *b, size_t nops)
+{
+	double start = now();
+	for (size_t i = 0; i < nops; i++)
+		bm->op(b, i);
+
+	return now() - start;
+}
+
+/*
+ * Runs the benchmark bm and prints its result. The number of operations per
+ * repetition is doubled until a repetition takes at least min_time, which
+ * also warms up the caches and the branch predictors, and then there are
+ * warmup more untimed repetitions. The statistics are of the time per
+ * operation over the repetitions: the median, the median absolute deviation
+ * from it, the minimum and the mean.
+ */
+static void run_one(const struct options *opt, const struct bench *bm,
+		    struct bctx *b, const char *shape, int *first)
+{
+	size_t reps = opt->reps;
+	double t[reps], dev[reps];
+	size_t nops = 1;
+
+	while (time_ops(bm, b, nops) < opt->min_time && nops < (1UL << 30))
+		nops *= 2;
+
+	for (size_t r = 0; r < opt->warmup; r++)
+		time_ops(bm, b, nops);
+
+	double mean = 0, min = -1;
+	for (size_t r = 0; r < reps; r++) {
+		t[r] = time_ops(bm, b, nops) * 1E9 / nops;
+		mean += t[r] / reps;
+		if (min < 0 || t[r] < min)
+			min = t[r];
+	}
+
+	double med = median(t, reps);
+	for (size_t r = 0; r < reps; r++)
+		dev[r] = t[r] > med ? t[r] - med : med - t[r];
+	double mad = median(dev, reps);
+
+	printf("%s\n    {\"name\": \"%s\", \"shape\": \"%s\", \"ops\": %zu, "
+	       "\"median_ns\": %.1f, \"mad_ns\": %.1f, \"min_ns\": %.1f, "
+	       "\"mean_ns\": %.1f}", *first ? "" : ",", bm->name, shape,
+	       nops, med, mad, min, mean);
+	fflush(stdout);
+	*first = 0;
+}
+
+/* Stores a row of a codeword with errs errors at distinct positions in r */
+static void gen_row(struct bctx *b, uint16_t *r, int errs)
+{
+	size_t cols = b->pc->cols;
+	int nn = b->pc->row_code->nn;
+	int hit[cols];
+
+	get_rcw_channel(b->pc, b->c, b->y, 0, b->rng);
+	memcpy(r, b->c, cols * sizeof(*r));
+	memset(hit, 0, sizeof(hit));
+
+	for (int k = 0; k < errs; k++) {
+		size_t pos;
+		uint16_t val;
+
+		do {
+			pos = gsl_rng_uniform_int(b->rng, cols);
+		} while (hit[pos]);
+
+		do {
+			val = gsl_rng_get(b->rng) & nn;
+		} while (!val);
+
+		hit[pos] = 1;
+		r[pos] ^= val;
+	}
+}
+
+static void free_bctx(struct bctx *b)
+{
+	pc_free(b->pc);
+	gsl_rng_free(b->rng);
+	free(b->c);
+	free(b->rows);
+	free(b->errlocs);
+	free(b->syn);
+	free(b->errpos);
+	free(b->errval);
+}
+
+static int alloc_bctx(struct bctx *b, const struct options *opt,
+		      const struct shape *sh)
+{
+	memset(b, 0, sizeof(*b));
+
+	b->pc = pc_init(sh->symsize, get_gfpoly(sh->symsize), 1, 1,
+			sh->r_nroots, 1, 1, sh->c_nroots, sh->rows, sh->cols);
+	check(b->pc, "could not initialize a %zux%zu product code",
+	      sh->rows, sh->cols);
+
+	b->rng = rng_alloc_and_seed(opt->rng_type, opt->seed);
+	check_mem(b->rng);
+
+	b->len = pc_len(b->pc);
+	b->c = malloc((NPAT_WORDS + 2) * b->len * sizeof(*b->c));
+	check_mem(b->c);
+	b->y = b->c + b->len;
+	b->words = b->y + b->len;
+
+	b->rows = malloc(NPAT_ROWS * sh->cols * sizeof(*b->rows));
+	b->errlocs = malloc(b->len * sizeof(*b->errlocs));
+	b->syn = malloc(sh->r_nroots * sizeof(*b->syn));
+	b->errpos = malloc(sh->r_nroots * sizeof(*b->errpos));
+	b->errval = malloc(sh->r_nroots * sizeof(*b->errval));
+	check_mem(b->rows && b->errlocs && b->syn && b->errpos && b->errval);
+	return 0;
+
+error:
+	free_bctx(b);
+	return -1;
+}
+
+static int matches(const struct options *opt, const char *name)
+{
+	return !opt->filter || strstr(name, opt->filter);
+}
+
+static int bench_shape(const struct options *opt, const struct shape *sh,
+		       int *first)
+{
+	struct bctx b;
+	char shape[64], name[64];
+	struct bench bm;
+
+	if (alloc_bctx(&b, opt, sh))
+		return -1;
+
+	snprintf(shape, sizeof(shape), "%zu:%zux%zu:%zu:%zu", sh->symsize,
+		 sh->rows, sh->cols, sh->r_nroots, sh->c_nroots);
+
+	/* The row decoders, at weights up to and just beyond the capacity */
+	int t = sh->r_nroots / 2;
+	int weights[] = { 0, 1, t / 2, t, t + 1 };
+	for (size_t k = 0; k < ARRAY_SIZE(weights); k++) {
+		if (k && weights[k] <= weights[k - 1])
+			continue;
+
+		for (size_t i = 0; i < NPAT_ROWS; i++)
+			gen_row(&b, b.rows + i * sh->cols, weights[k]);
+
+		snprintf(name, sizeof(name), "rs_decode/w=%d", weights[k]);
+		bm = (struct bench) { name, op_rs_decode };
+		if (matches(opt, name))
+			run_one(opt, &bm, &b, shape, first);
+
+		snprintf(name, sizeof(name), "rsdec_decode/w=%d", weights[k]);
+		bm = (struct bench) { name, op_rsdec_decode };
+		if (matches(opt, name))
+			run_one(opt, &bm, &b, shape, first);
+	}
+
+	/* The encoder and the channel */
+	b.errs = (pc_mind(b.pc) - 1) / 2;
+	b.p = 0.8 * t / sh->cols;
+	get_rcw_channel(b.pc, b.c, b.y, 0, b.rng);
+	static const struct bench gen[] = {
+		{ "gen_random_msg", op_msg },
+		{ "pc_encode", op_encode },
+		{ "add_channel_errors", op_channel },
+		{ "get_rcw_we", op_we },
+	};
+	for (size_t k = 0; k < ARRAY_SIZE(gen); k++)
+		if (matches(opt, gen[k].name))
+			run_one(opt, &gen[k], &b, shape, first);
+
+	/*
+	 * The decoders, on words with errors up to half the minimum distance,
+	 * which all of them correct, and on words from the channel with on
+	 * average 0.8 times as many errors per row as the row code corrects.
+	 */
+	static const char *const patterns[] = { "uc", "channel" };
+	for (size_t k = 0; k < ARRAY_SIZE(patterns); k++) {
+		for (size_t i = 0; i < NPAT_WORDS; i++) {
+			uint16_t *r = b.words + i * b.len;
+			if (k)
+				get_rcw_channel(b.pc, b.c, r, b.p, b.rng);
+			else
+				get_rcw_we(b.pc, b.c, r, b.errs, b.errlocs,
+					   b.rng);
+		}
+
+		snprintf(name, sizeof(name), "decode/copy/%s", patterns[k]);
+		bm = (struct bench) { name, op_copy };
+		if (matches(opt, name))
+			run_one(opt, &bm, &b, shape, first);
+
+		alg_ptr alg;
+		for (size_t a = 0; (alg = algorithm_by_index(a)); a++) {
+			snprintf(name, sizeof(name), "decode/%s/%s",
+				 algorithm_get_name(alg), patterns[k]);
+			b.alg = alg;
+			bm = (struct bench) { name, op_decode };
+			if (matches(opt, name))
+				run_one(opt, &bm, &b, shape, first);
+		}
+	}
+
+	free_bctx(&b);
+	return 0;
+}
+
+int run_bench_suite(struct options *opt)
+{
+	int first = 1;
+
+	printf("{\n  \"version\": \"%u.%u.%u\",\n  \"gf\": \"%s\",\n"
+	       "  \"seed\": %lu,\n  \"reps\": %zu,\n  \"results\": [",
+	       g_current_version.major, g_current_version.minor,
+	       g_current_version.patch, gf_ops_get()->name, opt->seed,
+	       opt->reps);
+
+	for (size_t i = 0; i < ARRAY_SIZE(shapes); i++) {
+		if (bench_shape(opt, &shapes[i], &first))
+			return -1;
+	}
+
+	printf("\n  ]\n}\n");
+	return 0;
+}
@@ -0,0 +1,165 @@
+/*
+ * block_file.c
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#define _GNU_SOURCE
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "block_file.h"
+#include "dbg.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+void block_get_msg(const struct block_layout *l, const uint16_t *blk,
+		   void *msg)
+{
+	size_t mrows = l->rows - l->c_nroots;
+	size_t mcols = l->cols - l->r_nroots;
+
+	for (size_t i = 0; i < mrows; i++) {
+		const uint16_t *row = blk + i * l->cols;
+		if (block_sym_bytes(l) == 1) {
+			uint8_t *m = (uint8_t *) msg + i * mcols;
+			for (size_t j = 0; j < mcols; j++)
+				m[j] = row[j];
+		} else {
+			memcpy((uint16_t *) msg + i * mcols, row,
+			       mcols * sizeof(*row));
+		}
+	}
+}
+
+size_t block_put_msg(const struct block_layout *l, uint16_t *blk,
+		     const void *msg, size_t n)
+{
+	size_t mcols = l->cols - l->r_nroots;
+	size_t len = block_msg_len(l);
+	uint16_t mask = (1U << l->symsize) - 1;
+	size_t bad = n;
+
+	for (size_t k = 0; k < len; k++) {
+		uint16_t x = 0;
+		if (k < n) {
+			if (block_sym_bytes(l) == 1)
+				x = ((const uint8_t *) msg)[k];
+			else
+				x = ((const uint16_t *) msg)[k];
+		}
+
+		if ((x & ~mask) && bad == n)
+			bad = k;
+		blk[k / mcols * l->cols + k % mcols] = x & mask;
+	}
+
+	return bad;
+}
+
+void block_layout_print(FILE *file, const struct block_layout *l,
+			const char *prefix)
+{
+	fprintf(file, "%sBlock: %zu x %zu symbols of %zu bits\n", prefix,
+		l->rows, l->cols, l->symsize);
+	fprintf(file, "%s  Row code: (%zu, %zu, %zu)\n", prefix,
+		l->cols, l->cols - l->r_nroots, l->r_nroots + 1);
+	fprintf(file, "%s  Col code: (%zu, %zu, %zu)\n", prefix,
+		l->rows, l->rows - l->c_nroots, l->c_nroots + 1);
+}
+
+int block_file_open(struct block_file *f, const char *path, size_t size)
+{
+	struct stat st;
+	int prot = PROT_READ;
+
+	f->map = NULL;
+	if (size) {
+		f->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+		check(f->fd >= 0, "cannot open '%s'", path);
+		check(!ftruncate(f->fd, size), "cannot resize '%s'", path);
+		prot |= PROT_WRITE;
+	} else {
+		f->fd = open(path, O_RDONLY);
+		check(f->fd >= 0, "cannot open '%s'", path);
+		check(!fstat(f->fd, &st), "cannot stat '%s'", path);
+		size = st.st_size;
+	}
+
+	f->size = size;
+	if (!size)
+		return 0;
+
+	f->map = mmap(NULL, size, prot, MAP_SHARED, f->fd, 0);
+	check(f->map != MAP_FAILED, "cannot map '%s'", path);
+
+	/* The blocks are taken in order, by one thread or a few */
+	madvise(f->map, size, MADV_SEQUENTIAL);
+	return 0;
+
+error:
+	if (f->fd >= 0)
+		close(f->fd);
+	f->fd = -1;
+	f->map = NULL;
+	return -1;
+}
+
+int block_file_close(struct block_file *f)
+{
+	int ret = 0;
+
+	if (f->map) {
+		if (msync(f->map, f->size, MS_SYNC))
+			ret = -1;
+		munmap(f->map, f->size);
+	}
+
+	if (f->fd >= 0 && close(f->fd))
+		ret = -1;
+
+	return ret;
+}
+
+void block_file_copy(const struct block_file *in, struct block_file *out,
+		     size_t off, size_t len)
+{
+#ifdef HAVE_COPY_FILE_RANGE
+	off64_t in_off = off, out_off = off;
+
+	while (len) {
+		ssize_t n = copy_file_range(in->fd, &in_off, out->fd, &out_off,
+					    len, 0);
+		if (n <= 0)
+			break;
+
+		off += n;
+		len -= n;
+	}
+
+	if (!len)
+		return;
+#endif
+
+	/* Across file systems, or without copy_file_range */
+	memcpy((char *) out->map + off, (const char *) in->map + off, len);
+}
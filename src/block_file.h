@@ -0,0 +1,93 @@
+/*
+ * block_file.h
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#ifndef FB_PCDECODE_BLOCK_FILE_H
+#define FB_PCDECODE_BLOCK_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Files of product code blocks, as written by pcenc and read by pcdec. A
+ * block is a codeword of rows * cols symbols, stored in row-major order with
+ * two bytes per symbol in the byte order of the machine, which is how the
+ * decoders take their words. The blocks are stored one after the other.
+ *
+ * The message of a block is the top left (rows - c_nroots) x (cols -
+ * r_nroots) corner of it. In message files a symbol takes one byte for symbol
+ * sizes up to 8 and two bytes, in the byte order of the machine, otherwise.
+ */
+struct block_layout {
+	size_t symsize;
+	size_t rows;
+	size_t cols;
+	size_t r_nroots;
+	size_t c_nroots;
+};
+
+/* A file mapped into memory */
+struct block_file {
+	int fd;
+	void *map;
+	size_t size;
+};
+
+static inline size_t block_len(const struct block_layout *l)
+{ return l->rows * l->cols; }
+
+static inline size_t block_bytes(const struct block_layout *l)
+{ return block_len(l) * sizeof(uint16_t); }
+
+static inline size_t block_msg_len(const struct block_layout *l)
+{ return (l->rows - l->c_nroots) * (l->cols - l->r_nroots); }
+
+static inline size_t block_sym_bytes(const struct block_layout *l)
+{ return l->symsize <= 8 ? 1 : 2; }
+
+/* Copies the message of the block blk into msg */
+void block_get_msg(const struct block_layout *l, const uint16_t *blk,
+		   void *msg);
+
+/* Sets the message of the block blk to the n symbols in msg, followed by
+ * zeros if n is less than the length of a message. Returns the index of the
+ * first symbol that does not fit in symsize bits, or n if they all do. */
+size_t block_put_msg(const struct block_layout *l, uint16_t *blk,
+		     const void *msg, size_t n);
+
+void block_layout_print(FILE *file, const struct block_layout *l,
+			const char *prefix);
+
+/* Maps the file at path. If size is zero the existing file is mapped for
+ * reading. Otherwise the file is created or truncated to size bytes and
+ * mapped for writing. Returns 0 on success and -1 on failure. */
+int block_file_open(struct block_file *f, const char *path, size_t size);
+
+/* Writes back the changes to a file mapped for writing and closes it. Returns
+ * 0 on success and -1 if the changes could not be written. */
+int block_file_close(struct block_file *f);
+
+/* Copies the len bytes at offset off of in to the same offset of out. The
+ * kernel copies them, without reading them into user space, if it can. */
+void block_file_copy(const struct block_file *in, struct block_file *out,
+		     size_t off, size_t len);
+
+#endif /* FB_PCDECODE_BLOCK_FILE_H */
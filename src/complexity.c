@@ -23,6 +23,8 @@
 #include "gen_errors.h"
 #include "algorithm.h"
 #include "rng.h"
+#include "perf_counters.h"
+#include "histogram.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -44,6 +46,9 @@ struct thread_args {
 	struct wspace *ws;
 	gsl_rng *rng;
 	struct stats s;
+	int counters;
+	struct perf_counters pf;	/* of the decoding */
+	struct histogram *lat;		/* of the decoding, in ns */
 };
 
 static struct wspace *alloc_ws(int len)
@@ -85,7 +90,8 @@ static void free_ws(struct wspace *ws)
 
 static void print_start(FILE *file, struct pc *pc,
 			const char *prefix, unsigned long seed,
-			size_t nthreads, const char *alg)
+			size_t nthreads, int counters, const double *dec_us,
+			const char *alg)
 {
 	static const char *const col_heads[] = {
 		"number of errors in codeword",
@@ -98,21 +104,106 @@ static void print_start(FILE *file, struct pc *pc,
 		"decoding failures",
 		"reported failures",
 	};
+	static const char *const latency_heads[] = {
+		"median decoding latency, microseconds",
+		"99th percentile of the decoding latency, microseconds",
+		"99.9th percentile of the decoding latency, microseconds",
+		"largest decoding latency, microseconds",
+	};
+	size_t ncols = ARRAY_SIZE(col_heads);
 
 	pc_print(file, pc, prefix);
 	fprintf(file, "%sAlgorithm: %s\n", prefix, alg);
 	fprintf(file, "%sSeed: %lu\n", prefix, seed);
 	fprintf(file, "%sThreads: %zu\n", prefix, nthreads);
+	if (counters) {
+		struct perf_counters pf;
+		int n = perf_counters_open(&pf);
+
+		perf_counters_close(&pf);
+		fprintf(file, "%sHardware counters: %d of %d available\n",
+			prefix, n, PERF_NCOUNTERS);
+	}
+	if (dec_us) {
+		fprintf(file, "%sRow decode: %.3f microseconds\n", prefix,
+			dec_us[0]);
+		fprintf(file, "%sColumn decode: %.3f microseconds\n", prefix,
+			dec_us[1]);
+	}
 	for (size_t i = 0; i < ARRAY_SIZE(col_heads); i++)
 		fprintf(file, "%s(%zu) %s\n", prefix, i + 1, col_heads[i]);
+	for (size_t i = 0; dec_us && i < ARRAY_SIZE(latency_heads); i++)
+		fprintf(file, "%s(%zu) %s\n", prefix, ++ncols, latency_heads[i]);
+	if (counters)
+		perf_counters_print_heads(file, prefix, ncols + 1);
 }
 
 static void print_stats(FILE *file, struct stats *s, int errs)
 {
-	fprintf(file, "%d %zu %zu %zu %zu %zu %zu %zu %zu\n",
+	fprintf(file, "%d %zu %zu %zu %zu %zu %zu %zu %zu",
 		errs, s->nwords, s->viable, s->max,
 		s->rdec, s->rdec_max, s->cdec, s->dwrong, s->rfail);
-	fflush(file);
+}
+
+static inline uint64_t now_ns(void)
+{
+	struct timespec tp;
+
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return tp.tv_sec * 1000000000ULL + tp.tv_nsec;
+}
+
+/* The latency columns, in microseconds */
+static void print_latency(FILE *file, const struct histogram *h)
+{
+	fprintf(file, " %.3f %.3f %.3f %.3f",
+		histogram_percentile(h, 50) / 1E3,
+		histogram_percentile(h, 99) / 1E3,
+		histogram_percentile(h, 99.9) / 1E3, h->max / 1E3);
+}
+
+/*
+ * Returns the average time in microseconds of decoding, from the syndromes,
+ * a word of length len of the code rs with half as many errors as it
+ * corrects, or a negative value if out of memory. These are the units of the
+ * row and column decoder counts.
+ */
+static double time_rsdec(const struct rsdec *rs, size_t len, gsl_rng *rng)
+{
+	enum { NWORDS = 64, REPS = 64 };
+	uint16_t syn[rs->nroots], errval[rs->nroots];
+	int errpos[rs->nroots];
+
+	/* The zero word is a codeword */
+	uint16_t *words = calloc(NWORDS * len, sizeof(*words));
+	if (!words)
+		return -1;
+
+	for (size_t w = 0; w < NWORDS; w++) {
+		uint16_t *y = words + w * len;
+
+		for (int k = 0; k < rs->nroots / 4; k++) {
+			size_t pos;
+
+			do {
+				pos = gsl_rng_uniform_int(rng, len);
+			} while (y[pos]);
+
+			while (!y[pos])
+				y[pos] = gsl_rng_get(rng) & rs->nn;
+		}
+	}
+
+	uint64_t start = now_ns();
+	for (size_t j = 0; j < NWORDS * REPS; j++) {
+		rsdec_syndrome(rs, words + j % NWORDS * len, len, 1, syn);
+		if (!rsdec_syn_zero(rs, syn))
+			rsdec_decode(rs, syn, len, NULL, 0, errpos, errval);
+	}
+
+	double us = (now_ns() - start) / 1E3 / (NWORDS * REPS);
+	free(words);
+	return us;
 }
 
 /* Test up to error correction capacity */
@@ -127,10 +218,21 @@ static int test_uc(struct thread_args *args, int trials, int errs)
 	int len = pc_len(pc);
 
 	memset(s, 0, sizeof(*s));
+	if (args->counters)
+		perf_counters_open(&args->pf);
+	if (args->lat)
+		histogram_clear(args->lat);
 
 	for (int j = 0; j < trials; j++) {
 		get_rcw_we(pc, c, r, errs, errlocs, args->rng);
+		uint64_t t = args->lat ? now_ns() : 0;
+		if (args->counters)
+			perf_counters_start(&args->pf);
 		int derrs = args->decode(pc, r, s);
+		if (args->counters)
+			perf_counters_stop(&args->pf);
+		if (args->lat)
+			histogram_add(args->lat, now_ns() - t);
 
 		if (derrs < 0)
 			s->rfail++;
@@ -139,6 +241,9 @@ static int test_uc(struct thread_args *args, int trials, int errs)
 			s->dwrong++;
 	}
 
+	if (args->counters)
+		perf_counters_close(&args->pf);
+
 	s->nwords = trials;
 	return s->dwrong;
 }
@@ -149,6 +254,7 @@ static void free_stuff(struct thread_args *args, int nthreads)
 		pc_free(args[i].pc);
 		free_ws(args[i].ws);
 		gsl_rng_free(args[i].rng);
+		free(args[i].lat);
 	}
 }
 
@@ -165,7 +271,7 @@ static int alloc_stuff(struct thread_args *args, int nthreads, struct options *o
 			goto err;
 
 		int len = pc_len(args[i].pc);
-		args[i].ws = alloc_ws(len * len);
+		args[i].ws = alloc_ws(len);
 		if (!args[i].ws)
 			goto err;
 
@@ -174,6 +280,12 @@ static int alloc_stuff(struct thread_args *args, int nthreads, struct options *o
 			goto err;
 
 		args[i].decode = opt->alg;
+		args[i].counters = opt->counters;
+		if (opt->latency) {
+			args[i].lat = malloc(sizeof(*args[i].lat));
+			if (!args[i].lat)
+				goto err;
+		}
 	}
 
 	return 0;
@@ -189,6 +301,21 @@ static void consolidate_stats(struct thread_args *args, int nthreads, int errs)
 		stats_add(&args[0].s, &args[i].s);
 
 	print_stats(stdout, &args[0].s, errs);
+	if (args[0].lat) {
+		for (int i = 1; i < nthreads; i++)
+			histogram_merge(args[0].lat, args[i].lat);
+
+		print_latency(stdout, args[0].lat);
+	}
+	if (args[0].counters) {
+		for (int i = 1; i < nthreads; i++)
+			perf_counters_add(&args[0].pf, &args[i].pf);
+
+		perf_counters_print(stdout, &args[0].pf, args[0].s.nwords);
+	}
+
+	fputc('\n', stdout);
+	fflush(stdout);
 }
 
 static void test_mt(struct thread_args *args, int nthreads, int errs, int trials)
@@ -208,15 +335,49 @@ int run_complexity(struct options *opt)
 	if (ret)
 		return -1;
 
-	int t = (pc_mind(args[0].pc) - 1) / 2;
+	struct pc *pc = args[0].pc;
+	double dec_us[2];
+	if (opt->latency) {
+		/* Its own generator, to keep the words the same */
+		gsl_rng *rng = rng_alloc_and_seed(opt->rng_type, opt->seed);
+		if (!rng)
+			goto err;
+
+		dec_us[0] = time_rsdec(pc->row_dec, pc->cols, rng);
+		dec_us[1] = time_rsdec(pc->col_dec, pc->rows, rng);
+		gsl_rng_free(rng);
+		if (dec_us[0] < 0 || dec_us[1] < 0)
+			goto err;
+	}
+
+	int t = (pc_mind(pc) - 1) / 2;
 	int trials = opt->cword_num / opt->nthreads;
-	print_start(stdout, args[0].pc, "# ", opt->seed,
-		    opt->nthreads, algorithm_get_name(opt->alg));
+	print_start(stdout, pc, "# ", opt->seed, opt->nthreads, opt->counters,
+		    opt->latency ? dec_us : NULL,
+		    algorithm_get_name(opt->alg));
+
+	/* The tail at the worst weight is what to provision for */
+	uint64_t worst = 0;
+	int worst_errs = 0;
 
 	omp_set_num_threads(opt->nthreads);
-	for (int errs = 0; errs <= t; errs++)
+	for (int errs = 0; errs <= t; errs++) {
 		test_mt(args, opt->nthreads, errs, trials);
+		if (opt->latency &&
+		    histogram_percentile(args[0].lat, 99.9) >= worst) {
+			worst = histogram_percentile(args[0].lat, 99.9);
+			worst_errs = errs;
+		}
+	}
+
+	if (opt->latency)
+		printf("# Worst 99.9th percentile: %.3f microseconds at %d "
+		       "errors\n", worst / 1E3, worst_errs);
 
 	free_stuff(args, opt->nthreads);
 	return 0;
+
+err:
+	free_stuff(args, opt->nthreads);
+	return -1;
 }
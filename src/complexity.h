@@ -31,6 +31,8 @@ struct options {
 	size_t cword_num;
 	size_t nthreads;
 	unsigned long seed;
+	int counters;		/* read the hardware counters */
+	int latency;		/* time each decoding */
 	size_t rows;
 	size_t cols;
 
@@ -52,8 +52,21 @@ static int print_help(FILE *file)
 "      --r-nroots=NUM           The number of roots in the row code. The\n"
 "                                 minimum distance of the row code is\n"
 "                                 NUM + 1.\n"
+"      --counters               Read the hardware counters of the decoding\n"
+"                                 threads and add the cycles, instructions,\n"
+"                                 cache misses and branch misses per codeword\n"
+"                                 as columns. Counters that cannot be read,\n"
+"                                 such as in many containers, are nan.\n"
 "  -g, --gfpoly=POLY            The Galois Field polynomial to use. If POLY is zero,\n"
 "                                 then the default polynomial is used.\n"
+"      --latency                Time each decoding and add the median, the 99th\n"
+"                                 and 99.9th percentiles and the largest of\n"
+"                                 the latencies as columns, in microseconds.\n"
+"                                 The time of one row and one column decode\n"
+"                                 from the syndromes, for converting the\n"
+"                                 decoder counts to time, and the worst\n"
+"                                 99.9th percentile over the numbers of\n"
+"                                 errors are reported in the comments.\n"
 "  -n, --num-words=NUM          The minimum number of words to decode.\n"
 "  -R, --rng=RNG                The random number generator to use. To see a list of all\n"
 "                                 available generators give 'list' as argument.\n"
@@ -72,6 +85,8 @@ static void parse_cmdline(int argc, char *const argv[], struct options *opt)
 	static const char *optstring = "a:g:n:c:r:R:S:s:T:";
 	static struct option longopt[] = {
 		{ "algorithm", required_argument, NULL, 'a' },
+		{ "counters",  no_argument,	  NULL, 'C' },
+		{ "latency",   no_argument,	  NULL, 'L' },
 		{ "gfpoly",    required_argument, NULL, 'g' },
 		{ "num-words", required_argument, NULL, 'n' },
 		{ "threads",   required_argument, NULL, 'T' },
@@ -116,6 +131,12 @@ static void parse_cmdline(int argc, char *const argv[], struct options *opt)
 			}
 			break;
 		}
+		case 'C':
+			opt->counters = 1;
+			break;
+		case 'L':
+			opt->latency = 1;
+			break;
 		case 'c':
 			opt->cols = strtoul(optarg, &endptr, 10);
 			check(*endptr == '\0'
@@ -23,18 +23,22 @@
 #include <string.h>
 #include <stdlib.h>
 
-static void gen_random_cword(struct pc *pc, uint16_t *c,
-			     const gsl_rng *rng)
+void gen_random_msg(struct pc *pc, uint16_t *c, const gsl_rng *rng)
 {
 	int nn = pc->row_code->nn;
 	int rdlen = pc->cols - pc->row_code->nroots;
 	int cdlen = pc->rows - pc->col_code->nroots;
 
-	/* Load c with random data and encode */
+	/* Load c with random data */
 	for (int j = 0; j < cdlen; j++)
 		for (int i = 0; i < rdlen; i++)
 			c[j * pc->cols + i] = gsl_rng_get(rng) & nn;
+}
 
+static void gen_random_cword(struct pc *pc, uint16_t *c,
+			     const gsl_rng *rng)
+{
+	gen_random_msg(pc, c, rng);
 	pc_encode(pc, c);
 }
 
@@ -77,17 +81,13 @@ void get_rcw_we(struct pc *pc, uint16_t *c, uint16_t *r,
 	}
 }
 
-
-/* Returns the number of errors */
-int get_rcw_channel(struct pc *pc, uint16_t *c, uint16_t *r,
-		    double p, const gsl_rng *rng)
+int add_channel_errors(struct pc *pc, const uint16_t *c, uint16_t *r,
+		       double p, const gsl_rng *rng)
 {
 	int nn = pc->row_code->nn;
 	int len = pc_len(pc);
 	int errs = 0;
 
-	gen_random_cword(pc, c, rng);
-
 	/* Make copy and add errors and erasures */
 	memcpy(r, c, len * sizeof(*r));
 
@@ -110,3 +110,45 @@ int get_rcw_channel(struct pc *pc, uint16_t *c, uint16_t *r,
 
 	return errs;
 }
+
+/* Returns the number of errors */
+int get_rcw_channel(struct pc *pc, uint16_t *c, uint16_t *r,
+		    double p, const gsl_rng *rng)
+{
+	gen_random_cword(pc, c, rng);
+	return add_channel_errors(pc, c, r, p, rng);
+}
+
+int add_channel_errors_eras(struct pc *pc, const uint16_t *c, uint16_t *r,
+			    double p, double q, uint8_t *eras, int *neras,
+			    const gsl_rng *rng)
+{
+	int nn = pc->row_code->nn;
+	int len = pc_len(pc);
+	int errs = 0;
+
+	memcpy(r, c, len * sizeof(*r));
+	memset(eras, 0, (len + 7) / 8);
+	*neras = 0;
+
+	for (int i = 0; i < len; i++) {
+		if (gsl_rng_uniform(rng) > p)
+			continue;
+
+		int errval;
+
+		do {
+			errval = gsl_rng_get(rng) & nn;
+		} while (errval == 0);
+
+		r[i] ^= errval;
+		errs++;
+
+		if (gsl_rng_uniform(rng) < q) {
+			eras[i / 8] |= 1 << (i % 8);
+			(*neras)++;
+		}
+	}
+
+	return errs;
+}
@@ -25,10 +25,30 @@
 #include "product_code.h"
 #include "rng.h"
 
+/* Stores a random message in the message positions of c, without encoding
+ * it */
+void gen_random_msg(struct pc *pc, uint16_t *c, const gsl_rng *rng);
+
 void get_rcw_we(struct pc *pc, uint16_t *c, uint16_t *r,
 		int errs, int *errlocs, const gsl_rng *rng);
 
+/* Stores the codeword c with random errors, each symbol in error with
+ * probability p, in r. Returns the number of errors. */
+int add_channel_errors(struct pc *pc, const uint16_t *c, uint16_t *r,
+		       double p, const gsl_rng *rng);
+
+/* get_rcw_channel is gen_random_msg, pc_encode and add_channel_errors */
 int get_rcw_channel(struct pc *pc, uint16_t *c, uint16_t *r,
 		    double p, const gsl_rng *rng);
 
+/*
+ * Like add_channel_errors, but the channel flags each symbol in error as
+ * erased with probability q. The erasures are stored in the bitmap eras, in
+ * the format of pc_set_erasures, and their number in neras. Returns the
+ * number of errors, erasures included.
+ */
+int add_channel_errors_eras(struct pc *pc, const uint16_t *c, uint16_t *r,
+			    double p, double q, uint8_t *eras, int *neras,
+			    const gsl_rng *rng);
+
 #endif /* FB_PCDECODE_GEN_ERRORS_H */
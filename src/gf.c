@@ -0,0 +1,227 @@
+/*
+ * gf.c
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#include "gf.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GF_X86
+#include <immintrin.h>
+#endif
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+static inline uint8_t gf_mul_sym(const uint16_t *alpha_to,
+				 const uint16_t *index_of, int mm,
+				 uint16_t a, uint16_t b)
+{
+	int nn = (1 << mm) - 1;
+
+	if (!a || !b)
+		return 0;
+	return alpha_to[(index_of[a] + index_of[b]) % nn];
+}
+
+void gf_mul_init(struct gf_mul *k, const uint16_t *alpha_to,
+		 const uint16_t *index_of, int mm, uint16_t c)
+{
+	int nn = (1 << mm) - 1;
+
+	for (int x = 0; x < 16; x++) {
+		k->lo[x] = x <= nn ? gf_mul_sym(alpha_to, index_of, mm, c, x) : 0;
+		k->hi[x] = (x << 4) <= nn ?
+			gf_mul_sym(alpha_to, index_of, mm, c, x << 4) : 0;
+	}
+
+	/* Bit i of c * x is the parity of x and byte 7 - i of the matrix,
+	 * whose bit j is bit i of c * 2^j */
+	uint8_t col[8] = { 0 };
+	for (int j = 0; j < mm; j++)
+		col[j] = gf_mul_sym(alpha_to, index_of, mm, c, 1 << j);
+
+	k->mat = 0;
+	for (int i = 0; i < 8; i++) {
+		uint64_t row = 0;
+		for (int j = 0; j < mm; j++)
+			row |= (uint64_t) ((col[j] >> i) & 1) << j;
+		k->mat |= row << (8 * (7 - i));
+	}
+}
+
+static inline uint8_t mul_scalar(const struct gf_mul *k, uint8_t x)
+{ return k->lo[x & 0x0f] ^ k->hi[x >> 4]; }
+
+static void mul_tail(const struct gf_mul *k, uint8_t *dst,
+		     const uint8_t *src, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		dst[i] = mul_scalar(k, src[i]);
+}
+
+static void muladd_tail(const struct gf_mul *k, uint8_t *dst,
+			const uint8_t *src, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		dst[i] ^= mul_scalar(k, src[i]);
+}
+
+static void horner_tail(const struct gf_mul *k, uint8_t *acc,
+			const uint8_t *src, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		acc[i] = mul_scalar(k, acc[i]) ^ src[i];
+}
+
+#ifdef GF_X86
+/*
+ * Generates the kernels gf_mul_##isa, gf_muladd_##isa and gf_horner_##isa
+ * for vectors of W bytes. LOAD, STORE and XOR are the vector operations, and
+ * MUL(x) multiplies the vector x by the constant that SETUP(k) loads. The
+ * bytes after the last full vector are done with the tables.
+ */
+#define GF_KERNELS(isa, tgt, W, SETUP, MUL, LOAD, STORE, XOR)	\
+__attribute__((target(tgt)))					\
+static void gf_mul_##isa(const struct gf_mul *k, uint8_t *dst,		\
+			 const uint8_t *src, size_t n)			\
+{									\
+	SETUP(k);							\
+	size_t i = 0;							\
+	for (; i + W <= n; i += W)					\
+		STORE(dst + i, MUL(LOAD(src + i)));			\
+	mul_tail(k, dst + i, src + i, n - i);				\
+}									\
+									\
+__attribute__((target(tgt)))					\
+static void gf_muladd_##isa(const struct gf_mul *k, uint8_t *dst,	\
+			    const uint8_t *src, size_t n)		\
+{									\
+	SETUP(k);							\
+	size_t i = 0;							\
+	for (; i + W <= n; i += W)					\
+		STORE(dst + i, XOR(LOAD(dst + i), MUL(LOAD(src + i))));	\
+	muladd_tail(k, dst + i, src + i, n - i);			\
+}									\
+									\
+__attribute__((target(tgt)))					\
+static void gf_horner_##isa(const struct gf_mul *k, uint8_t *acc,	\
+			    const uint8_t *src, size_t n)		\
+{									\
+	SETUP(k);							\
+	size_t i = 0;							\
+	for (; i + W <= n; i += W)					\
+		STORE(acc + i, XOR(MUL(LOAD(acc + i)), LOAD(src + i)));	\
+	horner_tail(k, acc + i, src + i, n - i);			\
+}
+
+/* Split nibble tables with PSHUFB */
+#define SSSE3_SETUP(k)							\
+	const __m128i tlo = _mm_loadu_si128((const __m128i *) (k)->lo);	\
+	const __m128i thi = _mm_loadu_si128((const __m128i *) (k)->hi);	\
+	const __m128i mask = _mm_set1_epi8(0x0f)
+#define SSSE3_MUL(x)							\
+	_mm_xor_si128(							\
+		_mm_shuffle_epi8(tlo, _mm_and_si128(x, mask)),		\
+		_mm_shuffle_epi8(thi,					\
+			_mm_and_si128(_mm_srli_epi64(x, 4), mask)))
+#define SSSE3_LOAD(p) _mm_loadu_si128((const __m128i *) (p))
+#define SSSE3_STORE(p, x) _mm_storeu_si128((__m128i *) (p), x)
+
+GF_KERNELS(ssse3, "ssse3", 16, SSSE3_SETUP, SSSE3_MUL,
+	   SSSE3_LOAD, SSSE3_STORE, _mm_xor_si128)
+
+/* The same with the tables in both 128-bit lanes */
+#define AVX2_SETUP(k)							\
+	const __m256i tlo = _mm256_broadcastsi128_si256(		\
+		_mm_loadu_si128((const __m128i *) (k)->lo));		\
+	const __m256i thi = _mm256_broadcastsi128_si256(		\
+		_mm_loadu_si128((const __m128i *) (k)->hi));		\
+	const __m256i mask = _mm256_set1_epi8(0x0f)
+#define AVX2_MUL(x)							\
+	_mm256_xor_si256(						\
+		_mm256_shuffle_epi8(tlo, _mm256_and_si256(x, mask)),	\
+		_mm256_shuffle_epi8(thi,				\
+			_mm256_and_si256(_mm256_srli_epi64(x, 4), mask)))
+#define AVX2_LOAD(p) _mm256_loadu_si256((const __m256i *) (p))
+#define AVX2_STORE(p, x) _mm256_storeu_si256((__m256i *) (p), x)
+
+GF_KERNELS(avx2, "avx2", 32, AVX2_SETUP, AVX2_MUL,
+	   AVX2_LOAD, AVX2_STORE, _mm256_xor_si256)
+
+/* One affine transformation per vector with GFNI */
+#define GFNI_SETUP(k)							\
+	const __m256i mat = _mm256_set1_epi64x((long long) (k)->mat)
+#define GFNI_MUL(x) _mm256_gf2p8affine_epi64_epi8(x, mat, 0)
+
+GF_KERNELS(gfni, "gfni,avx2", 32, GFNI_SETUP, GFNI_MUL,
+	   AVX2_LOAD, AVX2_STORE, _mm256_xor_si256)
+#endif /* GF_X86 */
+
+static int supported(const char *name)
+{
+#ifdef GF_X86
+	__builtin_cpu_init();
+	if (!strcmp(name, "gfni"))
+		return __builtin_cpu_supports("gfni") &&
+		       __builtin_cpu_supports("avx2");
+	if (!strcmp(name, "avx2"))
+		return __builtin_cpu_supports("avx2");
+	if (!strcmp(name, "ssse3"))
+		return __builtin_cpu_supports("ssse3");
+#endif
+	return !strcmp(name, "scalar");
+}
+
+/* In order of preference */
+static const struct gf_ops gf_ops[] = {
+#ifdef GF_X86
+	{ "gfni", gf_mul_gfni, gf_muladd_gfni, gf_horner_gfni },
+	{ "avx2", gf_mul_avx2, gf_muladd_avx2, gf_horner_avx2 },
+	{ "ssse3", gf_mul_ssse3, gf_muladd_ssse3, gf_horner_ssse3 },
+#endif
+	{ "scalar", mul_tail, muladd_tail, horner_tail }
+};
+
+const struct gf_ops *gf_ops_by_name(const char *name)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(gf_ops); i++)
+		if (!strcmp(gf_ops[i].name, name))
+			return supported(name) ? &gf_ops[i] : NULL;
+
+	return NULL;
+}
+
+const struct gf_ops *gf_ops_get(void)
+{
+	const char *name = getenv("PCDECODE_GF");
+	if (name) {
+		const struct gf_ops *ops = gf_ops_by_name(name);
+		if (ops)
+			return ops;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(gf_ops); i++)
+		if (supported(gf_ops[i].name))
+			return &gf_ops[i];
+
+	/* Not reached, the scalar kernels are always supported */
+	return &gf_ops[ARRAY_SIZE(gf_ops) - 1];
+}
@@ -0,0 +1,73 @@
+/*
+ * gf.h
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#ifndef FB_PCDECODE_GF_H
+#define FB_PCDECODE_GF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Multiplication of regions of GF(2^m) symbols, m <= 8, stored one symbol per
+ * byte, by a constant. Multiplication by a constant is linear over GF(2), so
+ * the product can be looked up separately for the low and the high nibble of
+ * a symbol (PSHUFB), or computed as a bit matrix product (GF2P8AFFINEQB).
+ * Both work for any field polynomial.
+ *
+ * The kernels are chosen at run time from what the CPU supports. Setting the
+ * environment variable PCDECODE_GF to the name of a kernel overrides the
+ * choice, which is mostly useful for testing and benchmarking.
+ */
+
+/* The constant c in the forms the kernels need */
+struct gf_mul {
+	uint8_t lo[16];		/* c * x for the low nibble x */
+	uint8_t hi[16];		/* c * (x << 4) for the high nibble x */
+	uint64_t mat;		/* multiplication by c as a bit matrix */
+};
+
+struct gf_ops {
+	const char *name;
+	/* dst[i] = c * src[i]; dst may equal src */
+	void (*mul)(const struct gf_mul *k, uint8_t *dst,
+		    const uint8_t *src, size_t n);
+	/* dst[i] ^= c * src[i] */
+	void (*muladd)(const struct gf_mul *k, uint8_t *dst,
+		       const uint8_t *src, size_t n);
+	/* acc[i] = c * acc[i] ^ src[i], a Horner step for n interleaved
+	 * polynomials */
+	void (*horner)(const struct gf_mul *k, uint8_t *acc,
+		       const uint8_t *src, size_t n);
+};
+
+/* Prepares the constant c, in polynomial form, of the field with the given
+ * tables. */
+void gf_mul_init(struct gf_mul *k, const uint16_t *alpha_to,
+		 const uint16_t *index_of, int mm, uint16_t c);
+
+/* Returns the fastest kernels that the CPU supports */
+const struct gf_ops *gf_ops_get(void);
+
+/* Returns the kernels with the given name, or NULL if there are no such
+ * kernels or if the CPU does not support them. */
+const struct gf_ops *gf_ops_by_name(const char *name);
+
+#endif /* FB_PCDECODE_GF_H */
@@ -0,0 +1,92 @@
+/*
+ * histogram.c
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+
+#include "histogram.h"
+#include <string.h>
+
+static size_t bucket(uint64_t v)
+{
+	if (v < HIST_SUB)
+		return v;
+
+	int shift = 63 - __builtin_clzll(v) - HIST_SUB_BITS;
+	return shift * HIST_SUB + (v >> shift);
+}
+
+/* The largest value in bucket i */
+static uint64_t bucket_top(size_t i)
+{
+	if (i < HIST_SUB)
+		return i;
+
+	int shift = i / HIST_SUB - 1;
+	uint64_t top = i - shift * HIST_SUB;
+	return ((top + 1) << shift) - 1;
+}
+
+void histogram_clear(struct histogram *h)
+{
+	memset(h, 0, sizeof(*h));
+}
+
+void histogram_add(struct histogram *h, uint64_t v)
+{
+	h->count[bucket(v)]++;
+	h->n++;
+	if (v > h->max)
+		h->max = v;
+}
+
+void histogram_merge(struct histogram *h, const struct histogram *src)
+{
+	for (size_t i = 0; i < HIST_BUCKETS; i++)
+		h->count[i] += src->count[i];
+
+	h->n += src->n;
+	if (src->max > h->max)
+		h->max = src->max;
+}
+
+uint64_t histogram_percentile(const struct histogram *h, double p)
+{
+	if (!h->n)
+		return 0;
+
+	/* The rank of the value, counting from one */
+	double x = p / 100 * h->n;
+	uint64_t rank = x;
+	if (rank < x)
+		rank++;
+	if (rank < 1)
+		rank = 1;
+
+	uint64_t seen = 0;
+	for (size_t i = 0; i < HIST_BUCKETS; i++) {
+		seen += h->count[i];
+		if (seen >= rank) {
+			uint64_t top = bucket_top(i);
+			return top < h->max ? top : h->max;
+		}
+	}
+
+	return h->max;
+}
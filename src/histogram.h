@@ -0,0 +1,57 @@
+/*
+ * histogram.h
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+
+#ifndef FB_PCDECODE_HISTOGRAM_H
+#define FB_PCDECODE_HISTOGRAM_H
+
+#include <stdint.h>
+
+/*
+ * Histograms of latencies, or of other nonnegative integers, in the style of
+ * HdrHistogram. Values below HIST_SUB are counted exactly. Larger values are
+ * counted in HIST_SUB buckets per power of two, so a percentile is off by
+ * less than 1 / HIST_SUB of its value. The size is fixed, however many
+ * values are added.
+ */
+#define HIST_SUB_BITS 5
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+struct histogram {
+	uint64_t n;
+	uint64_t max;
+	uint64_t count[HIST_BUCKETS];
+};
+
+void histogram_clear(struct histogram *h);
+
+void histogram_add(struct histogram *h, uint64_t v);
+
+/* Adds the values of src to h */
+void histogram_merge(struct histogram *h, const struct histogram *src);
+
+/* Returns the smallest value such that p percent of the values are no larger,
+ * rounded up to the top of its bucket, but never above the largest value.
+ * Returns zero if h is empty. */
+uint64_t histogram_percentile(const struct histogram *h, double p);
+
+#endif /* FB_PCDECODE_HISTOGRAM_H */
@@ -0,0 +1,564 @@
+/*
+ * pc_ooc.c
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#include "pc_ooc.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* The syndromes are computed from tiles of this many rows and columns, which
+ * are copied out of the word so that the column syndromes can be computed
+ * from contiguous memory. A tile and its partial syndromes fit in L1. */
+#define PC_OOC_TILE_ROWS 64
+#define PC_OOC_TILE_COLS 256
+
+/* Initial number of entries in the correction log */
+#define PC_OOC_LOG_MIN 1024
+
+/* The sum of the corrections made to the symbol at pos */
+struct ooc_corr {
+	size_t pos;
+	size_t round;		/* the last round that corrected it */
+	uint16_t val;
+	uint16_t prev;		/* val at the start of that round */
+};
+
+/* The corrections of a word, hashed on their positions */
+struct ooc_log {
+	struct ooc_corr *corr;
+	size_t n, size;
+	size_t *slots;		/* index into corr plus one; zero if empty */
+	size_t nslots;		/* a power of two, twice size */
+	size_t *touched;	/* the entries corrected in this round */
+	size_t ntouched;
+	size_t round;
+	int full;		/* the log could not grow */
+};
+
+struct pc_ooc {
+	struct rsdec *row_dec;
+	struct rsdec *col_dec;
+	size_t rows;
+	size_t cols;
+	int nthreads;
+
+	uint16_t *row_syn;	/* r_nroots syndromes per row */
+	uint16_t *col_syn;	/* c_nroots syndromes per column */
+	uint16_t *part;		/* partial row syndromes of a band of tiles */
+
+	char *col_dirty, *row_dirty;	/* changed since last decoded */
+	char *col_fail, *row_fail;	/* last decoding failed */
+
+	/* The line decoder results of a pass */
+	size_t *idx;
+	int *ret;
+	int *pos;
+	uint16_t *val;
+
+	struct ooc_log log;
+	size_t ncorr;		/* symbols changed by the last decoding */
+};
+
+static void log_free(struct ooc_log *log)
+{
+	free(log->touched);
+	free(log->slots);
+	free(log->corr);
+}
+
+static int log_alloc(struct ooc_log *log, size_t size)
+{
+	log->size = size;
+	log->nslots = 2 * size;
+	log->corr = malloc(size * sizeof(*log->corr));
+	log->touched = malloc(size * sizeof(*log->touched));
+	log->slots = calloc(log->nslots, sizeof(*log->slots));
+	if (!log->corr || !log->touched || !log->slots)
+		return -1;
+
+	return 0;
+}
+
+static void log_reset(struct ooc_log *log)
+{
+	memset(log->slots, 0, log->nslots * sizeof(*log->slots));
+	log->n = 0;
+	log->ntouched = 0;
+	log->round = 1;
+	log->full = 0;
+}
+
+static inline size_t log_hash(const struct ooc_log *log, size_t pos)
+{ return (pos * 0x9E3779B97F4A7C15ULL >> 17) & (log->nslots - 1); }
+
+/* Returns the slot of the entry for pos, or the empty slot where it goes */
+static size_t *log_slot(const struct ooc_log *log, size_t pos)
+{
+	size_t h = log_hash(log, pos);
+
+	while (log->slots[h] && log->corr[log->slots[h] - 1].pos != pos)
+		h = (h + 1) & (log->nslots - 1);
+
+	return &log->slots[h];
+}
+
+/* Doubles the size of the log. The entries stay where they are, so only the
+ * slots have to be rebuilt. */
+static int log_grow(struct ooc_log *log)
+{
+	size_t size = 2 * log->size;
+	struct ooc_corr *corr = realloc(log->corr, size * sizeof(*corr));
+	if (!corr)
+		return -1;
+	log->corr = corr;
+
+	size_t *touched = realloc(log->touched, size * sizeof(*touched));
+	if (!touched)
+		return -1;
+	log->touched = touched;
+
+	size_t *slots = calloc(2 * size, sizeof(*slots));
+	if (!slots)
+		return -1;
+
+	free(log->slots);
+	log->slots = slots;
+	log->nslots = 2 * size;
+	log->size = size;
+	for (size_t i = 0; i < log->n; i++)
+		*log_slot(log, log->corr[i].pos) = i + 1;
+
+	return 0;
+}
+
+/* Adds the error value val at pos to the log */
+static void log_add(struct ooc_log *log, size_t pos, uint16_t val)
+{
+	if (log->full)
+		return;
+
+	size_t *slot = log_slot(log, pos);
+	if (!*slot) {
+		if (log->n == log->size) {
+			if (log_grow(log)) {
+				log->full = 1;
+				return;
+			}
+			slot = log_slot(log, pos);
+		}
+
+		log->corr[log->n] = (struct ooc_corr) { .pos = pos };
+		*slot = ++log->n;
+	}
+
+	struct ooc_corr *c = &log->corr[*slot - 1];
+	if (c->round != log->round) {
+		c->round = log->round;
+		c->prev = c->val;
+		log->touched[log->ntouched++] = *slot - 1;
+	}
+	c->val ^= val;
+}
+
+/* Ends a round. Returns nonzero if the corrections of the round changed the
+ * word, i.e., if they did not cancel out. */
+static int log_end_round(struct ooc_log *log)
+{
+	int changed = 0;
+
+	for (size_t i = 0; i < log->ntouched; i++) {
+		const struct ooc_corr *c = &log->corr[log->touched[i]];
+		changed |= c->val != c->prev;
+	}
+
+	log->ntouched = 0;
+	log->round++;
+	return changed;
+}
+
+static int corr_cmp(const void *a, const void *b)
+{
+	const struct ooc_corr *x = a, *y = b;
+
+	return (x->pos > y->pos) - (x->pos < y->pos);
+}
+
+/* Applies the corrections in the log to data, in the order of their positions
+ * so that the pages of a mapped word are written in order. Returns the number
+ * of symbols changed. The slots are no longer valid afterwards. */
+static size_t log_write_back(struct ooc_log *log, uint16_t *data)
+{
+	size_t n = 0;
+
+	qsort(log->corr, log->n, sizeof(*log->corr), corr_cmp);
+
+	for (size_t i = 0; i < log->n; i++) {
+		if (log->corr[i].val) {
+			data[log->corr[i].pos] ^= log->corr[i].val;
+			n++;
+		}
+	}
+
+	return n;
+}
+
+struct pc_ooc *pc_ooc_init(size_t symsize, size_t gfpoly,
+			   size_t r_fcr, size_t r_prim, size_t r_nroots,
+			   size_t c_fcr, size_t c_prim, size_t c_nroots,
+			   size_t rows, size_t cols)
+{
+	if (cols <= r_nroots || rows <= c_nroots)
+		return NULL;
+
+	struct pc_ooc *o = calloc(1, sizeof(*o));
+	if (!o)
+		return NULL;
+
+	o->rows = rows;
+	o->cols = cols;
+	o->nthreads = 1;
+
+	o->row_dec = rsdec_init(symsize, gfpoly, r_fcr, r_prim, r_nroots);
+	if (!o->row_dec)
+		goto err;
+
+	o->col_dec = rsdec_init(symsize, gfpoly, c_fcr, c_prim, c_nroots);
+	if (!o->col_dec)
+		goto err;
+
+	size_t nsyn = rows * r_nroots + cols * c_nroots;
+	o->row_syn = malloc(nsyn * sizeof(*o->row_syn));
+	if (!o->row_syn)
+		goto err;
+
+	o->col_syn = o->row_syn + rows * r_nroots;
+
+	size_t ntiles = (cols + PC_OOC_TILE_COLS - 1) / PC_OOC_TILE_COLS;
+	o->part = malloc(ntiles * PC_OOC_TILE_ROWS * r_nroots * sizeof(*o->part));
+	if (!o->part)
+		goto err;
+
+	o->col_dirty = malloc(2 * (rows + cols));
+	if (!o->col_dirty)
+		goto err;
+
+	o->row_dirty = o->col_dirty + cols;
+	o->col_fail = o->row_dirty + rows;
+	o->row_fail = o->col_fail + cols;
+
+	size_t nlines = rows > cols ? rows : cols;
+	size_t npos = rows * r_nroots > cols * c_nroots
+		      ? rows * r_nroots : cols * c_nroots;
+	o->idx = malloc(nlines * sizeof(*o->idx));
+	o->ret = malloc(nlines * sizeof(*o->ret));
+	o->pos = malloc(npos * sizeof(*o->pos));
+	o->val = malloc(npos * sizeof(*o->val));
+	if (!o->idx || !o->ret || !o->pos || !o->val)
+		goto err;
+
+	if (log_alloc(&o->log, PC_OOC_LOG_MIN))
+		goto err;
+
+	return o;
+
+err:
+	pc_ooc_free(o);
+	return NULL;
+}
+
+void pc_ooc_free(struct pc_ooc *o)
+{
+	if (!o)
+		return;
+
+	log_free(&o->log);
+	free(o->val);
+	free(o->pos);
+	free(o->ret);
+	free(o->idx);
+	free(o->col_dirty);
+	free(o->part);
+	free(o->row_syn);
+	rsdec_free(o->col_dec);
+	rsdec_free(o->row_dec);
+	free(o);
+}
+
+int pc_ooc_set_threads(struct pc_ooc *o, int nthreads)
+{
+	if (nthreads < 1)
+		nthreads = 1;
+
+	o->nthreads = nthreads;
+	return 0;
+}
+
+size_t pc_ooc_len(const struct pc_ooc *o)
+{ return o->rows * o->cols; }
+
+size_t pc_ooc_corrected(const struct pc_ooc *o)
+{ return o->ncorr; }
+
+/* As pc_encode */
+void pc_ooc_encode(struct pc_ooc *o, uint16_t *data)
+{
+	size_t row_dlen = o->cols - o->row_dec->nroots;
+
+	rsdec_encode_interleaved(o->col_dec, data, o->rows, row_dlen, o->cols);
+	rsdec_encode_words(o->row_dec, data, o->cols, o->rows);
+}
+
+static inline uint16_t *row_syn(struct pc_ooc *o, size_t i)
+{ return &o->row_syn[i * o->row_dec->nroots]; }
+
+static inline uint16_t *col_syn(struct pc_ooc *o, size_t i)
+{ return &o->col_syn[i * o->col_dec->nroots]; }
+
+/* The exponents, in index form, that move the syndromes of rs n symbols
+ * towards the start of a word: syndrome i is multiplied by root i to the
+ * power n. */
+static void syn_shift(const struct rsdec *rs, size_t n, int *shift)
+{
+	for (int i = 0; i < rs->nroots; i++)
+		shift[i] = ((unsigned long) rs->root[i] * n) % rs->nn;
+}
+
+/* Appends the symbols with the partial syndromes part to the part of a word
+ * with the syndromes syn, where shift is from syn_shift for the number of
+ * symbols appended. */
+static void syn_append(const struct rsdec *rs, uint16_t *syn,
+		       const int *shift, const uint16_t *part)
+{
+	for (int i = 0; i < rs->nroots; i++) {
+		if (syn[i])
+			syn[i] = rs->alpha_to[rsdec_modnn(rs,
+					rs->index_of[syn[i]] + shift[i])];
+		syn[i] ^= part[i];
+	}
+}
+
+/* Computes the syndromes of the tile of nr rows and nc columns at row rb and
+ * column cb of data. The column syndromes are appended to those of the rows
+ * above the tile, and the partial row syndromes are stored in part. */
+static void syn_tile(struct pc_ooc *o, const uint16_t *data, size_t rb,
+		     size_t nr, size_t cb, size_t nc, uint16_t *part)
+{
+	const struct rsdec *rs_r = o->row_dec;
+	const struct rsdec *rs_c = o->col_dec;
+	int c_nroots = rs_c->nroots;
+	uint16_t t[PC_OOC_TILE_ROWS * PC_OOC_TILE_COLS];
+	uint16_t cpart[PC_OOC_TILE_COLS * c_nroots];
+	int shift[c_nroots];
+
+	for (size_t j = 0; j < nr; j++)
+		memcpy(t + j * nc, data + (rb + j) * o->cols + cb,
+		       nc * sizeof(*t));
+
+	for (size_t j = 0; j < nr; j++)
+		rsdec_syndrome(rs_r, t + j * nc, nc, 1,
+			       part + j * rs_r->nroots);
+
+	rsdec_syndrome_interleaved(rs_c, t, nr, nc, cpart);
+	syn_shift(rs_c, nr, shift);
+	for (size_t k = 0; k < nc; k++)
+		syn_append(rs_c, col_syn(o, cb + k), shift,
+			   cpart + k * c_nroots);
+}
+
+/* Computes the syndromes of all rows and columns in one pass over data, band
+ * by band of rows. The tiles of a band are split across the team, and the
+ * partial row syndromes of the tiles are then appended in order. */
+static void compute_syndromes(struct pc_ooc *o, const uint16_t *data)
+{
+	const struct rsdec *rs_r = o->row_dec;
+	int r_nroots = rs_r->nroots;
+	size_t ntiles = (o->cols + PC_OOC_TILE_COLS - 1) / PC_OOC_TILE_COLS;
+	size_t last = o->cols - (ntiles - 1) * PC_OOC_TILE_COLS;
+	size_t band = PC_OOC_TILE_ROWS * r_nroots;
+	int shift[r_nroots], shift_last[r_nroots];
+
+	memset(o->row_syn, 0, (o->rows * r_nroots + o->cols
+			       * o->col_dec->nroots) * sizeof(*o->row_syn));
+	syn_shift(rs_r, PC_OOC_TILE_COLS, shift);
+	syn_shift(rs_r, last, shift_last);
+
+	for (size_t rb = 0; rb < o->rows; rb += PC_OOC_TILE_ROWS) {
+		size_t nr = o->rows - rb < PC_OOC_TILE_ROWS
+			    ? o->rows - rb : PC_OOC_TILE_ROWS;
+
+		#pragma omp parallel for num_threads(o->nthreads) \
+			if (o->nthreads > 1)
+		for (size_t k = 0; k < ntiles; k++) {
+			size_t nc = k == ntiles - 1 ? last : PC_OOC_TILE_COLS;
+			syn_tile(o, data, rb, nr, k * PC_OOC_TILE_COLS, nc,
+				 o->part + k * band);
+		}
+
+		for (size_t j = 0; j < nr; j++) {
+			uint16_t *syn = row_syn(o, rb + j);
+			for (size_t k = 0; k < ntiles; k++)
+				syn_append(rs_r, syn, k == ntiles - 1
+					   ? shift_last : shift,
+					   o->part + k * band + j * r_nroots);
+		}
+	}
+}
+
+/* Logs the error value val at row r and column c and updates the syndromes
+ * of the row and the column. */
+static void apply_corr(struct pc_ooc *o, size_t r, size_t c, uint16_t val)
+{
+	log_add(&o->log, r * o->cols + c, val);
+	rsdec_syn_update(o->row_dec, row_syn(o, r), o->cols, c, val);
+	rsdec_syn_update(o->col_dec, col_syn(o, c), o->rows, r, val);
+}
+
+/* Decodes the n lines in o->idx from their syndromes in syn */
+static void decode_lines(struct pc_ooc *o, const struct rsdec *rs,
+			 const uint16_t *syn, size_t len, size_t n)
+{
+	int nroots = rs->nroots;
+
+	#pragma omp parallel for num_threads(o->nthreads) \
+		if (o->nthreads > 1 && n > 1) schedule(dynamic, 8)
+	for (size_t k = 0; k < n; k++) {
+		size_t i = o->idx[k];
+		o->ret[k] = rsdec_decode(rs, syn + i * nroots, len, NULL, 0,
+					 o->pos + k * nroots,
+					 o->val + k * nroots);
+	}
+}
+
+/* The column pass of pc_decode_iter. Returns nonzero if some column was
+ * corrected. */
+static int col_pass(struct pc_ooc *o, struct stats *s)
+{
+	int nroots = o->col_dec->nroots;
+	int corrected = 0;
+	size_t n = 0;
+
+	for (size_t i = 0; i < o->cols; i++) {
+		if (!o->col_dirty[i])
+			continue;
+
+		o->col_dirty[i] = 0;
+		o->col_fail[i] = 0;
+		if (!rsdec_syn_zero(o->col_dec, col_syn(o, i)))
+			o->idx[n++] = i;
+	}
+
+	decode_lines(o, o->col_dec, o->col_syn, o->rows, n);
+
+	for (size_t k = 0; k < n; k++) {
+		size_t i = o->idx[k];
+		int ret = o->ret[k];
+		const int *pos = o->pos + k * nroots;
+		const uint16_t *val = o->val + k * nroots;
+
+		for (int j = 0; j < ret; j++) {
+			apply_corr(o, pos[j], i, val[j]);
+			o->row_dirty[pos[j]] = 1;
+		}
+
+		o->col_fail[i] = ret < 0;
+		corrected |= ret > 0;
+	}
+
+	PC_STAT(s, cdec, n);
+	return corrected;
+}
+
+/* Like col_pass, but for the rows. The columns that were corrected and were
+ * not dirty before are counted in ndirty. */
+static int row_pass(struct pc_ooc *o, size_t *ndirty, struct stats *s)
+{
+	int nroots = o->row_dec->nroots;
+	int corrected = 0;
+	size_t n = 0;
+
+	for (size_t i = 0; i < o->rows; i++) {
+		if (!o->row_dirty[i])
+			continue;
+
+		o->row_dirty[i] = 0;
+		o->row_fail[i] = 0;
+		if (!rsdec_syn_zero(o->row_dec, row_syn(o, i)))
+			o->idx[n++] = i;
+	}
+
+	decode_lines(o, o->row_dec, o->row_syn, o->cols, n);
+
+	for (size_t k = 0; k < n; k++) {
+		size_t i = o->idx[k];
+		int ret = o->ret[k];
+		const int *pos = o->pos + k * nroots;
+		const uint16_t *val = o->val + k * nroots;
+
+		for (int j = 0; j < ret; j++) {
+			apply_corr(o, i, pos[j], val[j]);
+			if (!o->col_dirty[pos[j]]) {
+				o->col_dirty[pos[j]] = 1;
+				(*ndirty)++;
+			}
+		}
+
+		o->row_fail[i] = ret < 0;
+		corrected |= ret > 0;
+	}
+
+	PC_STAT(s, rdec, n);
+	return corrected;
+}
+
+/* The rounds are those of pc_decode_iter, and so is the result, except that
+ * a full log fails the word. The word is never read after the syndromes have
+ * been computed. */
+int pc_ooc_decode(struct pc_ooc *o, uint16_t *data, struct stats *s)
+{
+	size_t ndirty;
+	int corrected, changed;
+	int fail = 0;
+
+	o->ncorr = 0;
+	compute_syndromes(o, data);
+	memset(o->col_dirty, 1, o->cols + o->rows);
+	memset(o->col_fail, 0, o->cols + o->rows);
+	log_reset(&o->log);
+
+	do {
+		ndirty = 0;
+		corrected = col_pass(o, s);
+		corrected |= row_pass(o, &ndirty, s);
+		changed = log_end_round(&o->log);
+		PC_STAT(s, rounds, 1);
+	} while (ndirty && changed && !o->log.full);
+
+	int undone = ndirty && corrected;
+	fail = o->log.full;
+	for (size_t i = 0; i < o->cols; i++)
+		fail |= o->col_fail[i];
+	for (size_t i = 0; i < o->rows; i++)
+		fail |= o->row_fail[i];
+
+	if (!fail && !undone)
+		o->ncorr = log_write_back(&o->log, data);
+
+	return fail ? -1 : undone;
+}
@@ -0,0 +1,71 @@
+/*
+ * pc_ooc.h
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#ifndef FB_PCDECODE_PC_OOC_H
+#define FB_PCDECODE_PC_OOC_H
+
+#include "product_code.h"
+
+/*
+ * Out-of-core iterative decoding, for codes too large to keep a few copies of
+ * a codeword in memory. The word is read once, in tiles, to compute the
+ * syndromes of all rows and columns. The decoding then runs on the syndromes
+ * alone, as pc_decode_iter does, with the corrections kept in a sparse log.
+ * Only the corrected symbols are written back, in place, and only if the word
+ * was decoded. The memory used is that of the syndromes and line flags plus
+ * the log, so a memory-mapped word needs no more RAM than the page cache is
+ * willing to give it.
+ *
+ * The words are stored as for the other decoders: rows * cols symbols of type
+ * uint16_t in row-major order.
+ */
+struct pc_ooc;
+
+/* Same parameters as pc_init */
+struct pc_ooc *pc_ooc_init(size_t symsize, size_t gfpoly,
+			   size_t r_fcr, size_t r_prim, size_t r_nroots,
+			   size_t c_fcr, size_t c_prim, size_t c_nroots,
+			   size_t rows, size_t cols);
+
+void pc_ooc_free(struct pc_ooc *o);
+
+/* Sets the number of threads that compute the syndromes and decode the lines
+ * of a pass. Returns 0 on success and -1 on failure. */
+int pc_ooc_set_threads(struct pc_ooc *o, int nthreads);
+
+/* Decodes the word in data in place. Returns zero if the word was decoded,
+ * and otherwise what pc_decode_iter would: -1 if a line could not be decoded,
+ * and 1 if the last round only undid earlier corrections. A log that could
+ * not grow also gives -1. data is only changed if zero is returned. */
+int pc_ooc_decode(struct pc_ooc *o, uint16_t *data, struct stats *s);
+
+/* Encodes the word in data in place, as pc_encode does, without using any
+ * buffers */
+void pc_ooc_encode(struct pc_ooc *o, uint16_t *data);
+
+/* The length in symbols of the words */
+size_t pc_ooc_len(const struct pc_ooc *o);
+
+/* The number of symbols changed by the last decoding. Zero if the word was
+ * a codeword or could not be decoded. */
+size_t pc_ooc_corrected(const struct pc_ooc *o);
+
+#endif /* FB_PCDECODE_PC_OOC_H */
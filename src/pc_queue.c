@@ -0,0 +1,332 @@
+/*
+ * pc_queue.c
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#include "pc_queue.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Chunks per worker in pc_queue_decode */
+#define PC_QUEUE_CHUNKS 4
+
+/* n words, one after the other, and where to store their results */
+struct job {
+	uint16_t *data;
+	size_t n;
+	int *ret;		/* NULL for a word from pc_queue_submit */
+	int res;		/* the result of such a word */
+	void *tag;
+};
+
+struct worker {
+	struct pc_queue *q;
+	struct pc *pc;
+	struct stats s;
+	pthread_t thread;
+};
+
+struct pc_queue {
+	alg_ptr alg;
+	pc_queue_fn fn;		/* instead of alg, with arg */
+	void *arg;
+	size_t len;
+	size_t depth;
+	size_t nworkers;
+	struct worker *workers;
+
+	/* Rings of depth jobs each. There are never more than depth jobs in
+	 * the queue, so neither ring can overflow. */
+	struct job *pending;
+	struct job *done;
+	size_t phead, npending;
+	size_t dhead, ndone;
+	size_t inflight;	/* submitted and not yet polled */
+	int stop;
+	int event[2];		/* readable while ndone > 0, see pc_queue_fd */
+
+	pthread_mutex_t lock;
+	pthread_cond_t work;	/* a job is pending or the queue stops */
+	pthread_cond_t finished;	/* a job is done */
+};
+
+/* The event pipe holds one byte while there are done jobs. It is only
+ * written and read with the lock held, as ndone goes from and to zero, so
+ * it never fills and the reads never block. */
+static void event_set(struct pc_queue *q)
+{
+	if (q->event[1] >= 0) {
+		ssize_t n = write(q->event[1], "", 1);
+		(void) n;
+	}
+}
+
+static void event_clear(struct pc_queue *q)
+{
+	char c;
+
+	if (q->event[0] >= 0) {
+		ssize_t n = read(q->event[0], &c, 1);
+		(void) n;
+	}
+}
+
+static void decode_job(struct worker *w, struct job *job)
+{
+	struct pc_queue *q = w->q;
+	int *ret = job->ret ? job->ret : &job->res;
+
+	for (size_t i = 0; i < job->n; i++) {
+		uint16_t *data = job->data + i * q->len;
+
+		ret[i] = q->fn ? q->fn(w->pc, data, &w->s, q->arg)
+			       : q->alg(w->pc, data, &w->s);
+	}
+}
+
+static void *worker_main(void *arg)
+{
+	struct worker *w = arg;
+	struct pc_queue *q = w->q;
+
+	pthread_mutex_lock(&q->lock);
+	for (;;) {
+		while (!q->npending && !q->stop)
+			pthread_cond_wait(&q->work, &q->lock);
+		if (!q->npending)
+			break;
+
+		struct job job = q->pending[q->phead];
+		q->phead = (q->phead + 1) % q->depth;
+		q->npending--;
+		pthread_mutex_unlock(&q->lock);
+
+		decode_job(w, &job);
+
+		pthread_mutex_lock(&q->lock);
+		q->done[(q->dhead + q->ndone) % q->depth] = job;
+		if (q->ndone++ == 0)
+			event_set(q);
+		pthread_cond_signal(&q->finished);
+	}
+	pthread_mutex_unlock(&q->lock);
+
+	return NULL;
+}
+
+static void free_workers(struct pc_queue *q, size_t nstarted)
+{
+	pthread_mutex_lock(&q->lock);
+	q->stop = 1;
+	pthread_cond_broadcast(&q->work);
+	pthread_mutex_unlock(&q->lock);
+
+	for (size_t i = 0; i < nstarted; i++)
+		pthread_join(q->workers[i].thread, NULL);
+	for (size_t i = 0; i < q->nworkers; i++)
+		pc_free(q->workers[i].pc);
+}
+
+static struct pc_queue *queue_init(const struct pc *pc, alg_ptr alg,
+				   pc_queue_fn fn, void *arg,
+				   size_t nworkers, size_t depth)
+{
+	size_t nstarted = 0;
+
+	if (nworkers < 1 || depth < 1)
+		return NULL;
+
+	struct pc_queue *q = calloc(1, sizeof(*q));
+	if (!q)
+		return NULL;
+
+	q->alg = alg;
+	q->fn = fn;
+	q->arg = arg;
+	q->len = pc_len(pc);
+	q->depth = depth;
+	q->nworkers = nworkers;
+	q->event[0] = q->event[1] = -1;
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->work, NULL);
+	pthread_cond_init(&q->finished, NULL);
+
+	q->pending = malloc(2 * depth * sizeof(*q->pending));
+	q->workers = calloc(nworkers, sizeof(*q->workers));
+	if (!q->pending || !q->workers)
+		goto err;
+
+	q->done = q->pending + depth;
+
+	for (size_t i = 0; i < nworkers; i++) {
+		q->workers[i].q = q;
+		q->workers[i].pc = pc_clone(pc);
+		if (!q->workers[i].pc)
+			goto err;
+	}
+
+	for (; nstarted < nworkers; nstarted++) {
+		struct worker *w = &q->workers[nstarted];
+		if (pthread_create(&w->thread, NULL, worker_main, w))
+			goto err;
+	}
+
+	return q;
+
+err:
+	if (q->workers)
+		free_workers(q, nstarted);
+	free(q->workers);
+	free(q->pending);
+	pthread_cond_destroy(&q->finished);
+	pthread_cond_destroy(&q->work);
+	pthread_mutex_destroy(&q->lock);
+	free(q);
+	return NULL;
+}
+
+struct pc_queue *pc_queue_init(const struct pc *pc, alg_ptr alg,
+			       size_t nworkers, size_t depth)
+{ return queue_init(pc, alg, NULL, NULL, nworkers, depth); }
+
+struct pc_queue *pc_queue_init_fn(const struct pc *pc, pc_queue_fn fn,
+				  void *arg, size_t nworkers, size_t depth)
+{ return queue_init(pc, NULL, fn, arg, nworkers, depth); }
+
+void pc_queue_free(struct pc_queue *q)
+{
+	if (!q)
+		return;
+
+	free_workers(q, q->nworkers);
+	if (q->event[0] >= 0) {
+		close(q->event[0]);
+		close(q->event[1]);
+	}
+	free(q->workers);
+	free(q->pending);
+	pthread_cond_destroy(&q->finished);
+	pthread_cond_destroy(&q->work);
+	pthread_mutex_destroy(&q->lock);
+	free(q);
+}
+
+/* Queues a job. Only the thread using the queue changes inflight, so the
+ * caller can check that there is room without the lock. */
+static void submit(struct pc_queue *q, const struct job *job)
+{
+	pthread_mutex_lock(&q->lock);
+	q->pending[(q->phead + q->npending) % q->depth] = *job;
+	q->npending++;
+	q->inflight++;
+	pthread_cond_signal(&q->work);
+	pthread_mutex_unlock(&q->lock);
+}
+
+/* Takes a done job from the queue. Returns 1 if there was one. */
+static int poll_job(struct pc_queue *q, struct job *job, int wait)
+{
+	pthread_mutex_lock(&q->lock);
+	while (!q->ndone) {
+		if (!wait || !q->inflight) {
+			pthread_mutex_unlock(&q->lock);
+			return 0;
+		}
+		pthread_cond_wait(&q->finished, &q->lock);
+	}
+
+	*job = q->done[q->dhead];
+	q->dhead = (q->dhead + 1) % q->depth;
+	q->inflight--;
+	if (--q->ndone == 0)
+		event_clear(q);
+	pthread_mutex_unlock(&q->lock);
+
+	return 1;
+}
+
+int pc_queue_submit(struct pc_queue *q, uint16_t *data, void *tag)
+{
+	struct job job = { .data = data, .n = 1, .ret = NULL, .tag = tag };
+
+	if (q->inflight == q->depth)
+		return -1;
+
+	submit(q, &job);
+	return 0;
+}
+
+int pc_queue_poll(struct pc_queue *q, void **tag, int *ret, int wait)
+{
+	struct job job;
+
+	if (!poll_job(q, &job, wait))
+		return 0;
+
+	*tag = job.tag;
+	*ret = job.res;
+	return 1;
+}
+
+int pc_queue_fd(struct pc_queue *q)
+{
+	pthread_mutex_lock(&q->lock);
+	if (q->event[0] < 0 && !pipe(q->event) && q->ndone)
+		event_set(q);
+	int fd = q->event[0];
+	pthread_mutex_unlock(&q->lock);
+
+	return fd;
+}
+
+size_t pc_queue_decode(struct pc_queue *q, uint16_t *data, size_t n, int *ret)
+{
+	size_t chunk = n / (PC_QUEUE_CHUNKS * q->nworkers);
+	struct job job, done;
+	size_t nfail = 0;
+
+	if (chunk < 1)
+		chunk = 1;
+
+	for (size_t i = 0; i < n; i += chunk) {
+		job.data = data + i * q->len;
+		job.n = n - i < chunk ? n - i : chunk;
+		job.ret = ret + i;
+		job.tag = NULL;
+		if (q->inflight == q->depth)
+			poll_job(q, &done, 1);
+		submit(q, &job);
+	}
+
+	while (poll_job(q, &done, 1))
+		;
+
+	for (size_t i = 0; i < n; i++)
+		nfail += ret[i] != 0;
+
+	return nfail;
+}
+
+void pc_queue_stats(const struct pc_queue *q, struct stats *s)
+{
+	for (size_t i = 0; i < q->nworkers; i++)
+		stats_add(s, &q->workers[i].s);
+}
@@ -0,0 +1,83 @@
+/*
+ * pc_queue.h
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#ifndef FB_PCDECODE_PC_QUEUE_H
+#define FB_PCDECODE_PC_QUEUE_H
+
+#include "algorithm.h"
+
+/*
+ * Decoding of many words with a pool of worker threads. Each worker has a
+ * clone of the code, and thus buffers of its own, which it keeps for the
+ * life of the queue. Words are decoded in place, and the result of a word is
+ * that of the decoder, zero if it was decoded.
+ *
+ * The functions of a queue are meant to be called from one thread.
+ */
+struct pc_queue;
+
+/* Creates a queue that decodes words of the code pc with the algorithm alg
+ * using nworkers threads. At most depth words can be in the queue at a time.
+ * Returns NULL on failure. */
+struct pc_queue *pc_queue_init(const struct pc *pc, alg_ptr alg,
+			       size_t nworkers, size_t depth);
+
+/* A decoder that also gets the argument given to pc_queue_init_fn. It is
+ * called from the workers, several at a time. */
+typedef int (*pc_queue_fn)(struct pc *pc, uint16_t *data, struct stats *s,
+			   void *arg);
+
+/* Like pc_queue_init, but decodes with fn, which gets arg. The result of a
+ * word is what fn returns. */
+struct pc_queue *pc_queue_init_fn(const struct pc *pc, pc_queue_fn fn,
+				  void *arg, size_t nworkers, size_t depth);
+
+/* Waits for the words in the queue to be decoded and frees the queue. */
+void pc_queue_free(struct pc_queue *q);
+
+/* Queues the word in data for decoding. The word belongs to the queue until
+ * pc_queue_poll returns its tag. Returns zero on success and -1 if the queue
+ * is full, in which case a word must be polled first. */
+int pc_queue_submit(struct pc_queue *q, uint16_t *data, void *tag);
+
+/* Takes a decoded word from the queue, stores its tag and its result in tag
+ * and ret and returns 1. If no word has been decoded, waits for one if wait
+ * is nonzero and some word is in the queue, and returns zero otherwise. */
+int pc_queue_poll(struct pc_queue *q, void **tag, int *ret, int wait);
+
+/* Returns a file descriptor that is readable while a decoded word waits to be
+ * polled, for waiting on the queue and on other files at once with poll or
+ * select. The descriptor belongs to the queue and must only be waited on.
+ * Returns -1 on failure. */
+int pc_queue_fd(struct pc_queue *q);
+
+/* Decodes the n words stored one after the other in data and stores the
+ * result of word i in ret[i]. The words are split across the workers in
+ * chunks. Returns the number of words that could not be decoded. The queue
+ * must be empty. */
+size_t pc_queue_decode(struct pc_queue *q, uint16_t *data, size_t n, int *ret);
+
+/* Adds the stats of the words decoded by the queue to s. The queue must be
+ * empty. The decoders of libpcdecode.a are built with PC_NO_STATS and keep
+ * no stats, so with the library this adds nothing to s. */
+void pc_queue_stats(const struct pc_queue *q, struct stats *s);
+
+#endif /* FB_PCDECODE_PC_QUEUE_H */
@@ -0,0 +1,59 @@
+/*
+ * pc_trace.h
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+
+#ifndef FB_PCDECODE_PC_TRACE_H
+#define FB_PCDECODE_PC_TRACE_H
+
+/*
+ * Static tracepoints in the decoders, of the provider pcdecode. Built with
+ * ./configure --enable-sdt they are USDT probes, a single nop each until a
+ * tracer such as bpftrace, perf or SystemTap attaches to them, e.g.
+ *
+ *   bpftrace -e 'usdt:./simulate:pcdecode:col_pass { @[arg1] = count(); }'
+ *
+ * Otherwise they are compiled out. The probes and their arguments are
+ *
+ *   col_pass(ncols, nfail)        a column pass of iter decoded ncols
+ *                                 columns, and nfail of them failed
+ *   row_pass(nrows, nfail)        the same for a row pass
+ *   iter_round(round, ndirty, nlog)
+ *                                 round of iter finished, leaving ndirty
+ *                                 columns dirty after nlog corrections
+ *   gmd_strategy(row, strategy, ncorr)
+ *                                 gmd accepted the candidate of the erasure
+ *                                 strategy for row, with ncorr corrections;
+ *                                 strategy is -1 if no candidate was accepted
+ *   gd_fallback(alg)              the cascade alg, a string, fell back to gd
+ */
+#ifdef PC_SDT
+#include <sys/sdt.h>
+
+#define PC_TRACE(...) STAP_PROBEV(pcdecode, __VA_ARGS__)
+#else
+/* Keeps the arguments used. The call does nothing and is optimized away. */
+static inline void pc_trace_off(int name, ...)
+{ (void) name; }
+
+#define PC_TRACE(name, ...) pc_trace_off(0, __VA_ARGS__)
+#endif
+
+#endif /* FB_PCDECODE_PC_TRACE_H */
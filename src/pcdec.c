@@ -0,0 +1,678 @@
+/*
+ * pcdec.c
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#define _GNU_SOURCE
+#include "pcdec.h"
+#include "algorithm.h"
+#include "block_file.h"
+#include "dbg.h"
+#include "histogram.h"
+#include "pc_ooc.h"
+#include "pc_queue.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <omp.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+enum outcome {
+	BLOCK_CLEAN,
+	BLOCK_CORRECTED,
+	BLOCK_FAILED,
+	BLOCK_LATE		/* passed on undecoded at its deadline */
+};
+
+static const char *const outcome_names[] = {
+	"clean", "corrected", "failed", "late"
+};
+
+struct worker {
+	struct pc *pc;
+	uint16_t *buf;		/* the block being decoded, for messages */
+};
+
+struct decoder {
+	const struct options *opt;
+	struct block_layout l;
+	struct block_file in;
+	struct block_file out;
+	size_t nblocks;
+	unsigned char *outcome;
+};
+
+/* Decodes the block blk, which is not a codeword, in place. A block only
+ * counts as decoded if the decoder turned it into a codeword. */
+static enum outcome decode_block(struct decoder *d, struct pc *pc,
+				 uint16_t *blk)
+{
+	int ret = d->opt->alg(pc, blk, NULL);
+
+	return !ret && pc_check(pc, blk) ? BLOCK_CORRECTED : BLOCK_FAILED;
+}
+
+/* Decodes block b in its place in the output file. The block is copied there
+ * first, and again if it could not be decoded, since the decoders may leave
+ * a block they fail on half corrected. */
+static enum outcome decode_to_blocks(struct decoder *d, struct worker *w,
+				     size_t b)
+{
+	size_t bytes = block_bytes(&d->l);
+	uint16_t *blk = (uint16_t *) ((char *) d->out.map + b * bytes);
+
+	block_file_copy(&d->in, &d->out, b * bytes, bytes);
+	if (pc_check(w->pc, blk))
+		return BLOCK_CLEAN;
+
+	enum outcome o = decode_block(d, w->pc, blk);
+	if (o == BLOCK_FAILED)
+		block_file_copy(&d->in, &d->out, b * bytes, bytes);
+
+	return o;
+}
+
+/* Decodes block b and writes its message to the output file. Only the blocks
+ * that have to be decoded are copied out of the input. */
+static enum outcome decode_to_msgs(struct decoder *d, struct worker *w,
+				   size_t b)
+{
+	const uint16_t *src = (const uint16_t *) d->in.map
+			      + b * block_len(&d->l);
+	char *msg = (char *) d->out.map
+		    + b * block_msg_len(&d->l) * block_sym_bytes(&d->l);
+	enum outcome o = BLOCK_CLEAN;
+
+	if (!pc_check(w->pc, src)) {
+		memcpy(w->buf, src, block_bytes(&d->l));
+		o = decode_block(d, w->pc, w->buf);
+	}
+
+	block_get_msg(&d->l, o == BLOCK_CORRECTED ? w->buf : src, msg);
+	return o;
+}
+
+static void free_workers(struct worker *w, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		free(w[i].buf);
+		pc_free(w[i].pc);
+	}
+}
+
+static int alloc_workers(struct decoder *d, struct worker *w, size_t n,
+			 int pc_threads)
+{
+	const struct options *opt = d->opt;
+
+	memset(w, 0, n * sizeof(*w));
+	for (size_t i = 0; i < n; i++) {
+		w[i].pc = pc_init(opt->symsize, opt->gfpoly, opt->r_fcr,
+				  opt->r_prim, opt->r_nroots, opt->c_fcr,
+				  opt->c_prim, opt->c_nroots, opt->rows,
+				  opt->cols);
+		if (!w[i].pc || pc_set_threads(w[i].pc, pc_threads))
+			goto err;
+
+		if (opt->data) {
+			w[i].buf = malloc(block_bytes(&d->l));
+			if (!w[i].buf)
+				goto err;
+		}
+	}
+
+	return 0;
+
+err:
+	free_workers(w, n);
+	return -1;
+}
+
+/* As in simulate, small blocks are decoded one per thread and large ones one
+ * at a time by all threads. */
+static int decode_all(struct decoder *d)
+{
+	const struct options *opt = d->opt;
+	size_t nworkers = opt->nthreads;
+	int pc_threads = 1;
+
+	if (opt->nthreads > 1 && (block_len(&d->l) >= PC_PAR_MIN_LEN
+				  || d->nblocks < opt->nthreads)) {
+		nworkers = 1;
+		pc_threads = opt->nthreads;
+	}
+
+	struct worker w[nworkers];
+	if (alloc_workers(d, w, nworkers, pc_threads))
+		return -1;
+
+	#pragma omp parallel for num_threads(nworkers) schedule(dynamic)
+	for (size_t b = 0; b < d->nblocks; b++) {
+		struct worker *wk = &w[omp_get_thread_num()];
+		d->outcome[b] = opt->data ? decode_to_msgs(d, wk, b)
+					  : decode_to_blocks(d, wk, b);
+	}
+
+	free_workers(w, nworkers);
+	return 0;
+}
+
+/* Decodes the blocks one at a time with pc_ooc, in place in the output file.
+ * Only the corrected symbols are written, on top of the copied block. */
+static int decode_all_ooc(struct decoder *d)
+{
+	const struct options *opt = d->opt;
+	size_t bytes = block_bytes(&d->l);
+
+	struct pc_ooc *o = pc_ooc_init(opt->symsize, opt->gfpoly, opt->r_fcr,
+				       opt->r_prim, opt->r_nroots, opt->c_fcr,
+				       opt->c_prim, opt->c_nroots, opt->rows,
+				       opt->cols);
+	if (!o)
+		return -1;
+
+	pc_ooc_set_threads(o, opt->nthreads);
+	for (size_t b = 0; b < d->nblocks; b++) {
+		uint16_t *blk = (uint16_t *) ((char *) d->out.map + b * bytes);
+
+		block_file_copy(&d->in, &d->out, b * bytes, bytes);
+		if (pc_ooc_decode(o, blk, NULL))
+			d->outcome[b] = BLOCK_FAILED;
+		else if (pc_ooc_corrected(o))
+			d->outcome[b] = BLOCK_CORRECTED;
+		else
+			d->outcome[b] = BLOCK_CLEAN;
+	}
+
+	pc_ooc_free(o);
+	return 0;
+}
+
+static void print_start(FILE *file, const struct decoder *d)
+{
+	const struct options *opt = d->opt;
+
+	block_layout_print(file, &d->l, "# ");
+	fprintf(file, "# Algorithm: %s%s\n", algorithm_get_name(opt->alg),
+		opt->ooc ? " (out of core)" : "");
+	fprintf(file, "# Threads: %zu\n", opt->nthreads);
+	fprintf(file, "# Output: %s\n", opt->data ? "messages" : "blocks");
+}
+
+static size_t print_result(FILE *file, const struct decoder *d, double t)
+{
+	size_t count[BLOCK_LATE] = { 0 };
+
+	for (size_t b = 0; b < d->nblocks; b++) {
+		count[d->outcome[b]]++;
+		if (d->opt->verbose)
+			fprintf(file, "%zu %s\n", b, outcome_names[d->outcome[b]]);
+	}
+
+	fprintf(file, "# Blocks: %zu\n", d->nblocks);
+	for (int i = 0; i < BLOCK_LATE; i++)
+		fprintf(file, "#   %s: %zu\n", outcome_names[i], count[i]);
+	fprintf(file, "# Time: %.3f s\n", t);
+	fprintf(file, "# Throughput: %.1f MB/s\n", d->in.size / t / 1E6);
+
+	return count[BLOCK_FAILED];
+}
+
+long run_decoder(const struct options *opt)
+{
+	struct decoder d = {
+		.opt = opt,
+		.l = { opt->symsize, opt->rows, opt->cols,
+		       opt->r_nroots, opt->c_nroots },
+		.in = { .fd = -1 }, .out = { .fd = -1 }
+	};
+	size_t bytes = block_bytes(&d.l);
+	long ret = -1;
+
+	if (block_file_open(&d.in, opt->input, 0))
+		goto error;
+
+	lcheck_pf(d.in.size % bytes == 0, log_err_ne, error,
+		  "the size of '%s' is not a multiple of the block size, "
+		  "%zu bytes", opt->input, bytes);
+
+	d.nblocks = d.in.size / bytes;
+	lcheck_pf(d.nblocks > 0, log_err_ne, error, "'%s' holds no blocks",
+		  opt->input);
+
+	size_t size = opt->data ? d.nblocks * block_msg_len(&d.l)
+				  * block_sym_bytes(&d.l) : d.in.size;
+	if (block_file_open(&d.out, opt->output, size))
+		goto error;
+
+	d.outcome = malloc(d.nblocks);
+	check_mem(d.outcome);
+
+	print_start(stdout, &d);
+
+	double t = omp_get_wtime();
+	int err = opt->ooc ? decode_all_ooc(&d) : decode_all(&d);
+	lcheck_pf(!err, log_err_ne, error, "cannot initialize the decoders");
+	t = omp_get_wtime() - t;
+
+	ret = print_result(stdout, &d, t);
+
+error:
+	free(d.outcome);
+	if (block_file_close(&d.out)) {
+		log_err("cannot write '%s'", opt->output);
+		ret = -1;
+	}
+	block_file_close(&d.in);
+	return ret;
+}
+
+/*
+ * Streaming. The blocks are read from a pipe, or any file, as they come,
+ * decoded out of order by a pc_queue and written in order. At most window
+ * blocks are between being read and being written, so a slow decoder or
+ * reader of the output stops the reading, and the writer of the input waits
+ * in turn. A block that is not decoded within the deadline is written as it
+ * was received, and the stream goes on.
+ *
+ * The queue decodes a copy of each block, in a work buffer of its own. There
+ * are twice as many work buffers as slots, and as room in the queue. A late
+ * block frees its slot at once and leaves its work buffer to the queue, so
+ * up to window late blocks can be decoding while the stream goes on. Beyond
+ * that, the reading waits for the queue to return one.
+ */
+enum slot_state {
+	SLOT_FREE,
+	SLOT_QUEUED,
+	SLOT_DONE
+};
+
+struct slot;
+
+struct work {
+	uint16_t *blk;		/* the block decoded by the queue */
+	struct slot *sl;	/* NULL once the block is written late */
+	struct work *next;	/* in the list of spare ones */
+};
+
+struct slot {
+	uint16_t *in;		/* the block as received */
+	struct work *w;
+	uint64_t t;		/* when it was received, in ns */
+	enum slot_state state;
+	enum outcome outcome;
+};
+
+struct stream {
+	const struct options *opt;
+	struct block_layout l;
+	FILE *report;
+	int in_fd;
+	int out_fd;
+	struct pc_queue *q;
+	alg_ptr alg;		/* that checked_decode runs */
+	struct slot *slots;
+	struct work *works;	/* 2 * window */
+	struct work *spare;
+	size_t nread;		/* blocks read */
+	size_t nwritten;	/* blocks written */
+	size_t fill;		/* bytes read of block nread */
+	int eof;
+	char *msg;
+	size_t count[BLOCK_LATE + 1];
+	struct histogram latency;
+};
+
+/* Decodes blk with the decoder of the stream st and returns the outcome, for
+ * pc_queue. */
+static int checked_decode(struct pc *pc, uint16_t *blk, struct stats *s,
+			  void *st)
+{
+	alg_ptr alg = ((const struct stream *) st)->alg;
+
+	if (pc_check(pc, blk))
+		return BLOCK_CLEAN;
+
+	return !alg(pc, blk, s) && pc_check(pc, blk) ? BLOCK_CORRECTED
+						     : BLOCK_FAILED;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * UINT64_C(1000000000) + ts.tv_nsec;
+}
+
+static int write_all(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+
+	while (len) {
+		ssize_t n = write(fd, p, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+
+		p += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static int write_block(struct stream *st, struct slot *sl, enum outcome o)
+{
+	const uint16_t *blk = o == BLOCK_CORRECTED ? sl->w->blk : sl->in;
+
+	st->count[o]++;
+	histogram_add(&st->latency, now_ns() - sl->t);
+	if (st->opt->verbose)
+		fprintf(st->report, "%zu %s\n", st->nwritten, outcome_names[o]);
+	st->nwritten++;
+
+	if (!st->opt->data)
+		return write_all(st->out_fd, blk, block_bytes(&st->l));
+
+	block_get_msg(&st->l, blk, st->msg);
+	return write_all(st->out_fd, st->msg,
+			 block_msg_len(&st->l) * block_sym_bytes(&st->l));
+}
+
+static void release_work(struct stream *st, struct work *w)
+{
+	w->sl = NULL;
+	w->next = st->spare;
+	st->spare = w;
+}
+
+static void collect(struct stream *st)
+{
+	void *tag;
+	int ret;
+
+	while (pc_queue_poll(st->q, &tag, &ret, 0)) {
+		struct work *w = tag;
+
+		/* The block was written late, and its slot is gone */
+		if (!w->sl) {
+			release_work(st, w);
+			continue;
+		}
+
+		w->sl->state = SLOT_DONE;
+		w->sl->outcome = ret;
+	}
+}
+
+/* Writes the blocks that are done, and those past their deadline, in order.
+ * Stores the time until the deadline of the first block still being decoded
+ * in wait, in ns, or UINT64_MAX if there is none. Returns -1 if the blocks
+ * could not be written. */
+static int write_ready(struct stream *st, uint64_t *wait)
+{
+	uint64_t deadline = st->opt->deadline * 1E6;
+
+	*wait = UINT64_MAX;
+	while (st->nwritten < st->nread) {
+		struct slot *sl = &st->slots[st->nwritten % st->opt->window];
+
+		if (sl->state == SLOT_DONE) {
+			int err = write_block(st, sl, sl->outcome);
+
+			release_work(st, sl->w);
+			sl->w = NULL;
+			sl->state = SLOT_FREE;
+			if (err)
+				return -1;
+			continue;
+		}
+
+		if (!deadline)
+			break;
+
+		uint64_t age = now_ns() - sl->t;
+		if (age < deadline) {
+			*wait = deadline - age;
+			break;
+		}
+
+		/* The queue keeps the work buffer until it is done */
+		int err = write_block(st, sl, BLOCK_LATE);
+
+		sl->w->sl = NULL;
+		sl->w = NULL;
+		sl->state = SLOT_FREE;
+		if (err)
+			return -1;
+	}
+
+	return 0;
+}
+
+/* Reads what is available of the next block. Returns 1 once it is whole,
+ * and -1 on errors. */
+static int read_some(struct stream *st)
+{
+	size_t bytes = block_bytes(&st->l);
+	struct slot *sl = &st->slots[st->nread % st->opt->window];
+
+	ssize_t n = read(st->in_fd, (char *) sl->in + st->fill,
+			 bytes - st->fill);
+	if (n < 0)
+		return errno == EINTR ? 0 : -1;
+
+	if (n == 0) {
+		st->eof = 1;
+		return 0;
+	}
+
+	st->fill += n;
+	return st->fill == bytes;
+}
+
+/* Queues the block just read, with a spare work buffer */
+static int queue_block(struct stream *st)
+{
+	struct slot *sl = &st->slots[st->nread % st->opt->window];
+	struct work *w = st->spare;
+
+	memcpy(w->blk, sl->in, block_bytes(&st->l));
+	w->sl = sl;
+	sl->t = now_ns();
+	if (pc_queue_submit(st->q, w->blk, w)) {
+		w->sl = NULL;
+		return -1;
+	}
+
+	st->spare = w->next;
+	sl->state = SLOT_QUEUED;
+	sl->w = w;
+	st->nread++;
+	st->fill = 0;
+	return 0;
+}
+
+static int stream_blocks(struct stream *st)
+{
+	const struct options *opt = st->opt;
+	struct pollfd fds[2] = {
+		{ .fd = pc_queue_fd(st->q), .events = POLLIN },
+		{ .fd = st->in_fd, .events = POLLIN }
+	};
+	uint64_t wait;
+
+	lcheck_pf(fds[0].fd >= 0, log_err, error,
+		  "cannot wait on the decoders");
+
+	for (;;) {
+		collect(st);
+		lcheck_pf(!write_ready(st, &wait), log_err, error,
+			  "cannot write '%s'", opt->output);
+
+		if (st->eof && st->nwritten == st->nread) {
+			lcheck_pf(st->fill == 0, log_err_ne, error,
+				  "'%s' ends in a partial block", opt->input);
+			return 0;
+		}
+
+		/* Read only if the block has a slot and a work buffer to go
+		 * to */
+		struct slot *next = &st->slots[st->nread % opt->window];
+		int nfds = !st->eof && st->nread - st->nwritten < opt->window
+			   && next->state == SLOT_FREE && st->spare ? 2 : 1;
+
+		struct timespec ts = {
+			.tv_sec = wait / 1000000000, .tv_nsec = wait % 1000000000
+		};
+		if (ppoll(fds, nfds, wait == UINT64_MAX ? NULL : &ts, NULL) < 0) {
+			lcheck_pf(errno == EINTR, log_err, error,
+				  "cannot wait for input");
+			continue;
+		}
+
+		if (nfds == 2 && fds[1].revents) {
+			int ret = read_some(st);
+
+			lcheck_pf(ret >= 0, log_err, error,
+				  "cannot read '%s'", opt->input);
+			lcheck_pf(!ret || !queue_block(st), log_err_ne, error,
+				  "cannot queue block %zu", st->nread);
+		}
+	}
+
+error:
+	return -1;
+}
+
+static void free_slots(struct stream *st)
+{
+	for (size_t i = 0; st->slots && i < st->opt->window; i++)
+		free(st->slots[i].in);
+	for (size_t i = 0; st->works && i < 2 * st->opt->window; i++)
+		free(st->works[i].blk);
+	free(st->slots);
+	free(st->works);
+}
+
+static void print_stream_result(const struct stream *st, double t)
+{
+	FILE *file = st->report;
+
+	fprintf(file, "# Blocks: %zu\n", st->nwritten);
+	for (int i = 0; i <= BLOCK_LATE; i++)
+		fprintf(file, "#   %s: %zu\n", outcome_names[i], st->count[i]);
+	fprintf(file, "# Time: %.3f s\n", t);
+	fprintf(file, "# Throughput: %.1f MB/s\n",
+		st->nwritten * block_bytes(&st->l) / t / 1E6);
+	fprintf(file, "# Latency: p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+		histogram_percentile(&st->latency, 50) / 1E6,
+		histogram_percentile(&st->latency, 99) / 1E6,
+		st->latency.max / 1E6);
+}
+
+long run_stream_decoder(const struct options *opt)
+{
+	struct stream st = {
+		.opt = opt,
+		.l = { opt->symsize, opt->rows, opt->cols,
+		       opt->r_nroots, opt->c_nroots },
+		.report = strcmp(opt->output, "-") ? stdout : stderr,
+		.in_fd = -1, .out_fd = -1
+	};
+	struct pc *pc = NULL;
+	long ret = -1;
+
+	histogram_clear(&st.latency);
+
+	if (!strcmp(opt->input, "-")) {
+		st.in_fd = STDIN_FILENO;
+	} else {
+		st.in_fd = open(opt->input, O_RDONLY);
+		check(st.in_fd >= 0, "cannot open '%s'", opt->input);
+	}
+
+	if (!strcmp(opt->output, "-")) {
+		st.out_fd = STDOUT_FILENO;
+	} else {
+		st.out_fd = open(opt->output, O_WRONLY | O_CREAT | O_TRUNC,
+				 0666);
+		check(st.out_fd >= 0, "cannot open '%s'", opt->output);
+	}
+
+	st.slots = calloc(opt->window, sizeof(*st.slots));
+	st.works = calloc(2 * opt->window, sizeof(*st.works));
+	check_mem(st.slots && st.works);
+	for (size_t i = 0; i < opt->window; i++) {
+		st.slots[i].in = malloc(block_bytes(&st.l));
+		check_mem(st.slots[i].in);
+	}
+	for (size_t i = 0; i < 2 * opt->window; i++) {
+		st.works[i].blk = malloc(block_bytes(&st.l));
+		check_mem(st.works[i].blk);
+		release_work(&st, &st.works[i]);
+	}
+
+	st.msg = malloc(block_msg_len(&st.l) * block_sym_bytes(&st.l));
+	check_mem(st.msg);
+
+	pc = pc_init(opt->symsize, opt->gfpoly, opt->r_fcr, opt->r_prim,
+		     opt->r_nroots, opt->c_fcr, opt->c_prim, opt->c_nroots,
+		     opt->rows, opt->cols);
+	lcheck_pf(pc, log_err_ne, error, "cannot initialize the decoders");
+
+	st.alg = opt->alg;
+	st.q = pc_queue_init_fn(pc, checked_decode, &st, opt->nthreads,
+				2 * opt->window);
+	lcheck_pf(st.q, log_err_ne, error, "cannot initialize the decoders");
+
+	block_layout_print(st.report, &st.l, "# ");
+	fprintf(st.report, "# Algorithm: %s\n", algorithm_get_name(opt->alg));
+	fprintf(st.report, "# Threads: %zu\n", opt->nthreads);
+	fprintf(st.report, "# Output: %s\n", opt->data ? "messages" : "blocks");
+	fprintf(st.report, "# Window: %zu blocks\n", opt->window);
+	if (opt->deadline > 0)
+		fprintf(st.report, "# Deadline: %g ms\n", opt->deadline);
+
+	double t = omp_get_wtime();
+	if (!stream_blocks(&st)) {
+		t = omp_get_wtime() - t;
+		print_stream_result(&st, t);
+		ret = st.count[BLOCK_FAILED] + st.count[BLOCK_LATE];
+	}
+
+error:
+	/* Waits for the late blocks */
+	pc_queue_free(st.q);
+	pc_free(pc);
+	free_slots(&st);
+	free(st.msg);
+	if (st.out_fd >= 0 && st.out_fd != STDOUT_FILENO && close(st.out_fd)) {
+		log_err("cannot write '%s'", opt->output);
+		ret = -1;
+	}
+	if (st.in_fd > STDIN_FILENO)
+		close(st.in_fd);
+	return ret;
+}
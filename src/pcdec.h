@@ -0,0 +1,59 @@
+/*
+ * pcdec.h
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#ifndef FB_PCDECODE_PCDEC_H
+#define FB_PCDECODE_PCDEC_H
+
+#include "product_code.h"
+
+struct options {
+	int (*alg)(struct pc *, uint16_t *, struct stats *);
+	const char *input;
+	const char *output;
+	size_t nthreads;
+	int data;		/* write the messages only */
+	int ooc;		/* decode with pc_ooc */
+	int verbose;		/* print the outcome of each block */
+	int stream;		/* INPUT or OUTPUT is a pipe */
+	size_t window;		/* blocks in flight when streaming */
+	double deadline;	/* ms a streamed block may take, or 0 */
+	size_t rows;
+	size_t cols;
+	size_t symsize;
+	size_t gfpoly;
+	size_t r_fcr;
+	size_t r_prim;
+	size_t r_nroots;
+	size_t c_fcr;
+	size_t c_prim;
+	size_t c_nroots;
+};
+
+/* Decodes the blocks of the input file into the output file. Returns the
+ * number of blocks that could not be decoded, or -1 on errors. */
+long run_decoder(const struct options *opt);
+
+/* As run_decoder, but reads and writes the blocks as a stream, so that the
+ * input and output can be pipes; "-" is stdin or stdout. The blocks that
+ * were passed on undecoded at their deadline count as not decoded. */
+long run_stream_decoder(const struct options *opt);
+
+#endif /* FB_PCDECODE_PCDEC_H */
@@ -0,0 +1,264 @@
+/*
+ * Decoding of files of product code blocks.
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#include "dbg.h"
+#include "version.h"
+#include "pcdec.h"
+#include "algorithm.h"
+#include <getopt.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+#include <stdlib.h>
+
+static int print_help(FILE *file)
+{
+	static const char *formatstr = "Usage: %s [OPTION]... INPUT OUTPUT\n\n%s\n";
+	static const char *helpstr =
+"Decode the product code blocks in INPUT, as written by pcenc, and write the\n"
+"corrected blocks to OUTPUT. A block that cannot be decoded is written as it\n"
+"is. The blocks are rows x cols symbols of two bytes each, in the byte order\n"
+"of the machine. Reports the outcome of the decoding to stdout.\n\n"
+"If INPUT or OUTPUT is -, the blocks are streamed from stdin or to stdout. The\n"
+"blocks are then decoded by a pool of threads as they arrive and written in\n"
+"order, and the report, with the latency of the blocks, goes to stderr if\n"
+"OUTPUT is stdout.\n\n"
+"Mandatory arguments to long options are mandatory for short options too.\n"
+"  -a, --algorithm=ALG		The decoding algorithm to use. To see a list of all\n"
+"                                 available algorithms give 'list' as argument.\n"
+"                                 The default is auto.\n"
+"  -c, --cols=NUM               The number of columns in a block.\n"
+"  -r, --rows=NUM               The number of rows in a block.\n"
+"      --c-nroots=NUM           The number of roots in the column code.\n"
+"                                 The minimum distance of the column code\n"
+"                                 is NUM + 1.\n"
+"      --r-nroots=NUM           The number of roots in the row code. The\n"
+"                                 minimum distance of the row code is\n"
+"                                 NUM + 1.\n"
+"      --deadline=MS            When streaming, write a block that has not been\n"
+"                                 decoded MS milliseconds after it arrived as\n"
+"                                 it is, and go on. Such blocks count as not\n"
+"                                 decoded, and leave the window at once. The\n"
+"                                 decoders finish up to a window of them in\n"
+"                                 the background. The default is no deadline.\n"
+"  -d, --data                   Write the messages of the blocks to OUTPUT\n"
+"                                 instead of the blocks, in the format read\n"
+"                                 by pcenc.\n"
+"  -g, --gfpoly=POLY            The Galois Field polynomial to use. If POLY is zero,\n"
+"                                 then the default polynomial is used.\n"
+"  -O, --out-of-core            Decode the blocks in place in OUTPUT, one at a\n"
+"                                 time, keeping only the syndromes and the\n"
+"                                 corrections in memory. For blocks too large\n"
+"                                 to copy. Only for the algorithm iter.\n"
+"  -s, --sym-size=NUM           The symbol size in bits.\n"
+"  -T, --threads=NUM            Number of computational threads to use. Large\n"
+"                                 blocks are decoded one at a time by all\n"
+"                                 threads, smaller ones one per thread.\n"
+"  -v, --verbose                Report the outcome of each block.\n"
+"  -w, --window=NUM             When streaming, the largest number of blocks\n"
+"                                 between being read and being written. The\n"
+"                                 reading waits while the window is full. The\n"
+"                                 default is four per thread.\n"
+"      --help                   Display this help and exit.\n"
+"      --version                Output version information and exit.\n\n"
+"The exit status is 0 if all blocks were decoded, 1 if some were not and 2\n"
+"on errors.\n";
+
+	return (fprintf(file, formatstr, PROGRAM_NAME, helpstr) < 0)
+	       ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static void parse_cmdline(int argc, char *const argv[], struct options *opt)
+{
+	static const char *optstring = "a:c:dg:Or:s:T:vw:";
+	static struct option longopt[] = {
+		{ "algorithm",	 required_argument, NULL, 'a' },
+		{ "cols",	 required_argument, NULL, 'c' },
+		{ "rows",	 required_argument, NULL, 'r' },
+		{ "r-nroots",	 required_argument, NULL, 'U' },
+		{ "c-nroots",	 required_argument, NULL, 'u' },
+		{ "data",	 no_argument,	    NULL, 'd' },
+		{ "deadline",	 required_argument, NULL, 'D' },
+		{ "gfpoly",	 required_argument, NULL, 'g' },
+		{ "out-of-core", no_argument,	    NULL, 'O' },
+		{ "sym-size",	 required_argument, NULL, 's' },
+		{ "threads",	 required_argument, NULL, 'T' },
+		{ "verbose",	 no_argument,	    NULL, 'v' },
+		{ "window",	 required_argument, NULL, 'w' },
+		{ "help",	 no_argument,	    NULL, 'H' },
+		{ "version",	 no_argument,	    NULL, 'V' },
+		{ 0,		 0,		    0,	  0   }
+	};
+
+	// Setting default options
+	*opt = (struct options) {
+		.alg = NULL,
+		.nthreads = 1,
+		.symsize = 0, .gfpoly = 0,
+		.rows = 0, .cols = 0,
+		.r_nroots = 0, .c_nroots = 0,
+		.r_fcr = 1, .c_fcr = 1,
+		.r_prim = 1, .c_prim = 1
+	};
+
+	// Parsing the command line
+	int ch;
+	char *endptr;
+	while ((ch = getopt_long(argc, argv, optstring, longopt, NULL)) != -1) {
+		switch (ch) {
+		case 'a':
+		{
+			if (!strcmp(optarg, "list")) {
+				exit(algorithm_print_names(stdout));
+			} else {
+				opt->alg = algorithm_by_name(optarg);
+				check(opt->alg, "invalid argument to option "
+				      "'%c': '%s'", ch, optarg);
+			}
+			break;
+		}
+		case 'c':
+			opt->cols = strtoul(optarg, &endptr, 10);
+			check(*endptr == '\0'
+			      && !(errno == ERANGE && opt->cols == ULONG_MAX),
+			      "invalid argument to option '%c': '%s'", ch, optarg);
+			break;
+		case 'r':
+			opt->rows = strtoul(optarg, &endptr, 10);
+			check(*endptr == '\0'
+			      && !(errno == ERANGE && opt->rows == ULONG_MAX),
+			      "invalid argument to option '%c': '%s'", ch, optarg);
+			break;
+		case 'd':
+			opt->data = 1;
+			break;
+		case 'D':
+			opt->deadline = strtod(optarg, &endptr);
+			check(*endptr == '\0' && errno != ERANGE
+			      && opt->deadline >= 0,
+			      "invalid argument to option '%s': '%s'",
+			      "deadline", optarg);
+			break;
+		case 'g':
+			opt->gfpoly = strtoul(optarg, &endptr, 0);
+			check(*endptr == '\0'
+			      && !(errno == ERANGE && opt->gfpoly == ULONG_MAX),
+			      "invalid argument to option '%c': '%s'", ch, optarg);
+			break;
+		case 'O':
+			opt->ooc = 1;
+			break;
+		case 's':
+			opt->symsize = strtoul(optarg, &endptr, 10);
+			check(*endptr == '\0'
+			      && !(errno == ERANGE && opt->symsize == ULONG_MAX)
+			      && opt->symsize <= 16,
+			      "invalid argument to option '%c': '%s'", ch, optarg);
+			break;
+		case 'U':
+			opt->r_nroots = strtoul(optarg, &endptr, 10);
+			check(*endptr == '\0'
+			      && !(errno == ERANGE && opt->r_nroots == ULONG_MAX),
+			      "invalid argument to option '%c': '%s'", ch, optarg);
+			break;
+		case 'u':
+			opt->c_nroots = strtoul(optarg, &endptr, 10);
+			check(*endptr == '\0'
+			      && !(errno == ERANGE && opt->c_nroots == ULONG_MAX),
+			      "invalid argument to option '%c': '%s'", ch, optarg);
+			break;
+		case 'T':
+			opt->nthreads = strtoul(optarg, &endptr, 10);
+			check(*endptr == '\0'
+			      && !(errno == ERANGE && opt->nthreads == ULONG_MAX)
+			      && opt->nthreads > 0,
+			      "invalid argument to option '%c': '%s'", ch, optarg);
+			break;
+		case 'v':
+			opt->verbose = 1;
+			break;
+		case 'w':
+			opt->window = strtoul(optarg, &endptr, 10);
+			check(*endptr == '\0'
+			      && !(errno == ERANGE && opt->window == ULONG_MAX)
+			      && opt->window > 0,
+			      "invalid argument to option '%c': '%s'", ch, optarg);
+			break;
+		case 'H':
+			exit(print_help(stdout));
+		case 'V':
+			exit(print_version(stdout));
+		default:
+			goto error;
+		}
+	}
+
+	check(argc - optind == 2, "expected the files INPUT and OUTPUT");
+	opt->input = argv[optind];
+	opt->output = argv[optind + 1];
+
+	// Check for mandatory arguments.
+	check(opt->symsize > 0, "missing mandatory option -- '%c'", 's');
+	check(opt->rows > 0, "missing mandatory option -- '%c'", 'r');
+	check(opt->cols > 0, "missing mandatory option -- '%c'", 'c');
+	check(opt->r_nroots > 0, "missing mandatory option -- '%s'", "r-nroots");
+	check(opt->c_nroots > 0, "missing mandatory option -- '%s'", "c-nroots");
+
+	// Checking that arguments are sane
+	opt->stream = !strcmp(opt->input, "-") || !strcmp(opt->output, "-");
+	check(strcmp(opt->input, opt->output) || !strcmp(opt->input, "-"),
+	      "INPUT and OUTPUT are the same");
+	check(opt->rows > opt->c_nroots && opt->cols > opt->r_nroots,
+	      "the blocks are too small for the number of roots");
+	if (!opt->alg)
+		opt->alg = opt->ooc ? pc_decode_iter : pc_decode_auto;
+	check(!opt->ooc || opt->alg == pc_decode_iter,
+	      "out-of-core decoding is only done with the algorithm 'iter'");
+	check(!opt->ooc || !opt->data,
+	      "the options '%s' and '%s' cannot be combined",
+	      "out-of-core", "data");
+	check(!opt->ooc || !opt->stream,
+	      "out-of-core decoding cannot be streamed");
+	if (!opt->window)
+		opt->window = 4 * opt->nthreads;
+
+	if (opt->gfpoly == 0)
+		opt->gfpoly = get_gfpoly(opt->symsize);
+
+	return;
+
+error:
+	fprintf(stderr, "Try '%s --help' for more information.\n", PROGRAM_NAME);
+	exit(2);
+}
+
+
+int main(int argc, char *argv[])
+{
+	struct options opt;
+	PROGRAM_NAME = argv[0];
+
+	parse_cmdline(argc, argv, &opt);
+
+	long ret = opt.stream ? run_stream_decoder(&opt) : run_decoder(&opt);
+	return ret < 0 ? 2 : ret > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
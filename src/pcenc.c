@@ -0,0 +1,98 @@
+/*
+ * pcenc.c
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#include "pcenc.h"
+#include "block_file.h"
+#include "dbg.h"
+#include "pc_ooc.h"
+#include <omp.h>
+#include <stdlib.h>
+
+/* The blocks are encoded in place in the output file. The encoder only
+ * needs the component codes, so one is shared by all threads. */
+int run_encoder(const struct options *opt)
+{
+	struct block_layout l = {
+		opt->symsize, opt->rows, opt->cols, opt->r_nroots, opt->c_nroots
+	};
+	struct block_file in = { .fd = -1 }, out = { .fd = -1 };
+	struct pc_ooc *o = NULL;
+	size_t symbytes = block_sym_bytes(&l);
+	size_t k = block_msg_len(&l);
+	int ret = -1;
+
+	if (block_file_open(&in, opt->input, 0))
+		goto error;
+
+	lcheck_pf(in.size % symbytes == 0, log_err_ne, error,
+		  "the size of '%s' is not a multiple of the symbol size, "
+		  "%zu bytes", opt->input, symbytes);
+
+	size_t nsym = in.size / symbytes;
+	size_t nblocks = (nsym + k - 1) / k;
+	lcheck_pf(nblocks > 0, log_err_ne, error, "'%s' is empty", opt->input);
+
+	if (block_file_open(&out, opt->output, nblocks * block_bytes(&l)))
+		goto error;
+
+	o = pc_ooc_init(opt->symsize, opt->gfpoly, opt->r_fcr, opt->r_prim,
+			opt->r_nroots, opt->c_fcr, opt->c_prim, opt->c_nroots,
+			opt->rows, opt->cols);
+	lcheck_pf(o, log_err_ne, error, "cannot initialize the encoder");
+
+	block_layout_print(stdout, &l, "# ");
+	fprintf(stdout, "# Threads: %zu\n", opt->nthreads);
+
+	size_t bad = nsym;
+	double t = omp_get_wtime();
+
+	#pragma omp parallel for num_threads(opt->nthreads) schedule(dynamic) \
+		reduction(min:bad)
+	for (size_t b = 0; b < nblocks; b++) {
+		uint16_t *blk = (uint16_t *) out.map + b * block_len(&l);
+		const char *msg = (const char *) in.map + b * k * symbytes;
+		size_t n = nsym - b * k < k ? nsym - b * k : k;
+
+		size_t i = block_put_msg(&l, blk, msg, n);
+		if (i < n && b * k + i < bad)
+			bad = b * k + i;
+		pc_ooc_encode(o, blk);
+	}
+
+	t = omp_get_wtime() - t;
+	lcheck_pf(bad == nsym, log_err_ne, error,
+		  "symbol %zu of '%s' does not fit in %zu bits",
+		  bad, opt->input, opt->symsize);
+
+	fprintf(stdout, "# Blocks: %zu\n", nblocks);
+	fprintf(stdout, "# Time: %.3f s\n", t);
+	fprintf(stdout, "# Throughput: %.1f MB/s\n", in.size / t / 1E6);
+	ret = 0;
+
+error:
+	pc_ooc_free(o);
+	if (block_file_close(&out)) {
+		log_err("cannot write '%s'", opt->output);
+		ret = -1;
+	}
+	block_file_close(&in);
+	return ret;
+}
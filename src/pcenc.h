@@ -0,0 +1,47 @@
+/*
+ * pcenc.h
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#ifndef FB_PCDECODE_PCENC_H
+#define FB_PCDECODE_PCENC_H
+
+#include <stddef.h>
+
+struct options {
+	const char *input;
+	const char *output;
+	size_t nthreads;
+	size_t rows;
+	size_t cols;
+	size_t symsize;
+	size_t gfpoly;
+	size_t r_fcr;
+	size_t r_prim;
+	size_t r_nroots;
+	size_t c_fcr;
+	size_t c_prim;
+	size_t c_nroots;
+};
+
+/* Encodes the messages in the input file into blocks in the output file.
+ * Returns 0 on success and -1 on failure. */
+int run_encoder(const struct options *opt);
+
+#endif /* FB_PCDECODE_PCENC_H */
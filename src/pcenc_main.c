@@ -0,0 +1,181 @@
+/*
+ * Encoding of files into product code blocks.
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#include "dbg.h"
+#include "version.h"
+#include "pcenc.h"
+#include "product_code.h"
+#include <getopt.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+#include <stdlib.h>
+
+static int print_help(FILE *file)
+{
+	static const char *formatstr = "Usage: %s [OPTION]... INPUT OUTPUT\n\n%s\n";
+	static const char *helpstr =
+"Encode the data in INPUT into product code blocks and write them to OUTPUT.\n"
+"The data is split into messages of (rows - c-nroots) x (cols - r-nroots)\n"
+"symbols, and the last one is padded with zeros. A symbol takes one byte for\n"
+"symbol sizes up to 8, and two bytes in the byte order of the machine\n"
+"otherwise. The blocks are rows x cols symbols of two bytes each.\n\n"
+"Mandatory arguments to long options are mandatory for short options too.\n"
+"  -c, --cols=NUM               The number of columns in a block.\n"
+"  -r, --rows=NUM               The number of rows in a block.\n"
+"      --c-nroots=NUM           The number of roots in the column code.\n"
+"                                 The minimum distance of the column code\n"
+"                                 is NUM + 1.\n"
+"      --r-nroots=NUM           The number of roots in the row code. The\n"
+"                                 minimum distance of the row code is\n"
+"                                 NUM + 1.\n"
+"  -g, --gfpoly=POLY            The Galois Field polynomial to use. If POLY is zero,\n"
+"                                 then the default polynomial is used.\n"
+"  -s, --sym-size=NUM           The symbol size in bits.\n"
+"  -T, --threads=NUM            Number of computational threads to use.\n"
+"      --help                   Display this help and exit.\n"
+"      --version                Output version information and exit.\n";
+
+	return (fprintf(file, formatstr, PROGRAM_NAME, helpstr) < 0)
+	       ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static void parse_cmdline(int argc, char *const argv[], struct options *opt)
+{
+	static const char *optstring = "c:g:r:s:T:";
+	static struct option longopt[] = {
+		{ "cols",	required_argument, NULL, 'c' },
+		{ "rows",	required_argument, NULL, 'r' },
+		{ "r-nroots",	required_argument, NULL, 'U' },
+		{ "c-nroots",	required_argument, NULL, 'u' },
+		{ "gfpoly",	required_argument, NULL, 'g' },
+		{ "sym-size",	required_argument, NULL, 's' },
+		{ "threads",	required_argument, NULL, 'T' },
+		{ "help",	no_argument,	   NULL, 'H' },
+		{ "version",	no_argument,	   NULL, 'V' },
+		{ 0,		0,		   0,	 0   }
+	};
+
+	// Setting default options
+	*opt = (struct options) {
+		.nthreads = 1,
+		.symsize = 0, .gfpoly = 0,
+		.rows = 0, .cols = 0,
+		.r_nroots = 0, .c_nroots = 0,
+		.r_fcr = 1, .c_fcr = 1,
+		.r_prim = 1, .c_prim = 1
+	};
+
+	// Parsing the command line
+	int ch;
+	char *endptr;
+	while ((ch = getopt_long(argc, argv, optstring, longopt, NULL)) != -1) {
+		switch (ch) {
+		case 'c':
+			opt->cols = strtoul(optarg, &endptr, 10);
+			check(*endptr == '\0'
+			      && !(errno == ERANGE && opt->cols == ULONG_MAX),
+			      "invalid argument to option '%c': '%s'", ch, optarg);
+			break;
+		case 'r':
+			opt->rows = strtoul(optarg, &endptr, 10);
+			check(*endptr == '\0'
+			      && !(errno == ERANGE && opt->rows == ULONG_MAX),
+			      "invalid argument to option '%c': '%s'", ch, optarg);
+			break;
+		case 'g':
+			opt->gfpoly = strtoul(optarg, &endptr, 0);
+			check(*endptr == '\0'
+			      && !(errno == ERANGE && opt->gfpoly == ULONG_MAX),
+			      "invalid argument to option '%c': '%s'", ch, optarg);
+			break;
+		case 's':
+			opt->symsize = strtoul(optarg, &endptr, 10);
+			check(*endptr == '\0'
+			      && !(errno == ERANGE && opt->symsize == ULONG_MAX)
+			      && opt->symsize <= 16,
+			      "invalid argument to option '%c': '%s'", ch, optarg);
+			break;
+		case 'U':
+			opt->r_nroots = strtoul(optarg, &endptr, 10);
+			check(*endptr == '\0'
+			      && !(errno == ERANGE && opt->r_nroots == ULONG_MAX),
+			      "invalid argument to option '%c': '%s'", ch, optarg);
+			break;
+		case 'u':
+			opt->c_nroots = strtoul(optarg, &endptr, 10);
+			check(*endptr == '\0'
+			      && !(errno == ERANGE && opt->c_nroots == ULONG_MAX),
+			      "invalid argument to option '%c': '%s'", ch, optarg);
+			break;
+		case 'T':
+			opt->nthreads = strtoul(optarg, &endptr, 10);
+			check(*endptr == '\0'
+			      && !(errno == ERANGE && opt->nthreads == ULONG_MAX)
+			      && opt->nthreads > 0,
+			      "invalid argument to option '%c': '%s'", ch, optarg);
+			break;
+		case 'H':
+			exit(print_help(stdout));
+		case 'V':
+			exit(print_version(stdout));
+		default:
+			goto error;
+		}
+	}
+
+	check(argc - optind == 2, "expected the files INPUT and OUTPUT");
+	opt->input = argv[optind];
+	opt->output = argv[optind + 1];
+
+	// Check for mandatory arguments.
+	check(opt->symsize > 0, "missing mandatory option -- '%c'", 's');
+	check(opt->rows > 0, "missing mandatory option -- '%c'", 'r');
+	check(opt->cols > 0, "missing mandatory option -- '%c'", 'c');
+	check(opt->r_nroots > 0, "missing mandatory option -- '%s'", "r-nroots");
+	check(opt->c_nroots > 0, "missing mandatory option -- '%s'", "c-nroots");
+
+	// Checking that arguments are sane
+	check(strcmp(opt->input, opt->output), "INPUT and OUTPUT are the same");
+	check(opt->rows > opt->c_nroots && opt->cols > opt->r_nroots,
+	      "the blocks are too small for the number of roots");
+
+	if (opt->gfpoly == 0)
+		opt->gfpoly = get_gfpoly(opt->symsize);
+
+	return;
+
+error:
+	fprintf(stderr, "Try '%s --help' for more information.\n", PROGRAM_NAME);
+	exit(EXIT_FAILURE);
+}
+
+
+int main(int argc, char *argv[])
+{
+	struct options opt;
+	PROGRAM_NAME = argv[0];
+
+	parse_cmdline(argc, argv, &opt);
+
+	return run_encoder(&opt) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+/*
+ * pctrace.c
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#include "pctrace.h"
+#include "trial_trace.h"
+#include "dbg.h"
+#include <stdio.h>
+#include <string.h>
+
+static void print_start(FILE *file, const struct trace_header *h,
+			const struct options *opt)
+{
+	if (opt->csv) {
+		fprintf(file, "p");
+		for (size_t i = 0; i < trace_ncols; i++)
+			fprintf(file, ",%s", trace_cols[i].name);
+		fprintf(file, opt->errors ? ",errors\n" : "\n");
+		return;
+	}
+
+	fprintf(file, "# Trace: %s\n", opt->input);
+	fprintf(file, "# Symbol size: %u\n", (unsigned) h->symsize);
+	fprintf(file, "# Rows: %u, column code roots: %u\n",
+		(unsigned) h->rows, (unsigned) h->c_nroots);
+	fprintf(file, "# Columns: %u, row code roots: %u\n",
+		(unsigned) h->cols, (unsigned) h->r_nroots);
+	fprintf(file, "# Algorithm: %.*s\n", (int) sizeof(h->alg), h->alg);
+	fprintf(file, "# Seed: %llu\n", (unsigned long long) h->seed);
+	if (h->p_eras > 0)
+		fprintf(file, "# Erasures: %g\n", h->p_eras);
+
+	fprintf(file, "# (1) channel error probability\n");
+	for (size_t i = 0; i < trace_ncols; i++)
+		fprintf(file, "# (%zu) %s\n", i + 2, trace_cols[i].desc);
+	if (opt->errors)
+		fprintf(file, "# (%zu) errors, position:value\n",
+			trace_ncols + 2);
+}
+
+static void print_block(FILE *file, const struct trace_data *d,
+			const struct options *opt)
+{
+	char sep = opt->csv ? ',' : ' ';
+	const uint32_t *pos = d->pos;
+	const uint16_t *val = d->val;
+
+	for (size_t r = 0; r < d->hdr.n; r++) {
+		const struct trace_rec *rec = &d->recs[r];
+
+		fprintf(file, "%f", d->hdr.p);
+		for (size_t i = 0; i < trace_ncols; i++)
+			fprintf(file, "%c%u", sep,
+				(unsigned) trace_rec_get(rec, i));
+
+		if (opt->errors) {
+			fputc(sep, file);
+			for (size_t i = 0; i < rec->errs; i++)
+				fprintf(file, "%s%u:%u", i ? ";" : "",
+					(unsigned) pos[i], (unsigned) val[i]);
+		}
+		pos += rec->errs;
+		val += rec->errs;
+
+		fputc('\n', file);
+	}
+}
+
+int run_dump(const struct options *opt)
+{
+	struct trace_header h;
+	struct trace_data d;
+	int ret;
+
+	memset(&d, 0, sizeof(d));
+
+	FILE *file = fopen(opt->input, "rb");
+	check(file, "cannot open '%s'", opt->input);
+	if (trace_read_header(file, &h))
+		goto error;
+
+	lcheck_pf(!opt->errors || h.flags & TRACE_ERRORS, log_err_ne, error,
+		  "'%s' has no error patterns", opt->input);
+
+	print_start(stdout, &h, opt);
+	while ((ret = trace_read_block(file, &h, &d)) > 0)
+		print_block(stdout, &d, opt);
+
+	if (ret < 0)
+		goto error;
+
+	check(!ferror(file), "cannot read '%s'", opt->input);
+	trace_data_free(&d);
+	fclose(file);
+	return 0;
+
+error:
+	trace_data_free(&d);
+	if (file)
+		fclose(file);
+	return -1;
+}
@@ -0,0 +1,35 @@
+/*
+ * pctrace.h
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#ifndef FB_PCDECODE_PCTRACE_H
+#define FB_PCDECODE_PCTRACE_H
+
+struct options {
+	const char *input;
+	int csv;		/* instead of columns with a commented header */
+	int errors;		/* print the error patterns */
+};
+
+/* Prints the records of the trace written by simulate --trace to stdout.
+ * Returns 0 on success and -1 on failure. */
+int run_dump(const struct options *opt);
+
+#endif /* FB_PCDECODE_PCTRACE_H */
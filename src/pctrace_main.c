@@ -0,0 +1,103 @@
+/*
+ * Dumps the traces of the trials of simulate.
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#include "dbg.h"
+#include "version.h"
+#include "pctrace.h"
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static int print_help(FILE *file)
+{
+	static const char *formatstr = "Usage: %s [OPTION]... TRACE\n\n%s\n";
+	static const char *helpstr =
+"Print the records of TRACE, written by simulate --trace, one trial per line\n"
+"in the column format of simulate. The trials of a channel error probability\n"
+"are in no particular order. Outputs to stdout.\n\n"
+"  -c, --csv                    Print comma-separated values with a line of\n"
+"                                 column names instead.\n"
+"  -e, --errors                 Add the error pattern of each trial as a last\n"
+"                                 column of position:value pairs separated by\n"
+"                                 semicolons. The position is the index of the\n"
+"                                 symbol in the word, row by row, and the value\n"
+"                                 is the error added to it. Requires a trace\n"
+"                                 written with --trace-errors.\n"
+"      --help                   Display this help and exit.\n"
+"      --version                Output version information and exit.\n";
+
+	return (fprintf(file, formatstr, PROGRAM_NAME, helpstr) < 0)
+	       ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static void parse_cmdline(int argc, char *const argv[], struct options *opt)
+{
+	static const char *optstring = "ce";
+	static struct option longopt[] = {
+		{ "csv",	no_argument,	   NULL, 'c' },
+		{ "errors",	no_argument,	   NULL, 'e' },
+		{ "help",	no_argument,	   NULL, 'H' },
+		{ "version",	no_argument,	   NULL, 'V' },
+		{ 0,		0,		   0,	 0   }
+	};
+
+	// Setting default options
+	*opt = (struct options) { .input = NULL };
+
+	// Parsing the command line
+	int ch;
+	while ((ch = getopt_long(argc, argv, optstring, longopt, NULL)) != -1) {
+		switch (ch) {
+		case 'c':
+			opt->csv = 1;
+			break;
+		case 'e':
+			opt->errors = 1;
+			break;
+		case 'H':
+			exit(print_help(stdout));
+		case 'V':
+			exit(print_version(stdout));
+		default:
+			goto error;
+		}
+	}
+
+	check(argc - optind == 1, "expected the file TRACE");
+	opt->input = argv[optind];
+
+	return;
+
+error:
+	fprintf(stderr, "Try '%s --help' for more information.\n", PROGRAM_NAME);
+	exit(EXIT_FAILURE);
+}
+
+
+int main(int argc, char *argv[])
+{
+	struct options opt;
+	PROGRAM_NAME = argv[0];
+
+	parse_cmdline(argc, argv, &opt);
+
+	return run_dump(&opt) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,193 @@
+/*
+ * perf_counters.c
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#define _GNU_SOURCE
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "perf_counters.h"
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef HAVE_LINUX_PERF_EVENT_H
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+
+static const struct {
+	uint32_t type;
+	uint64_t config;
+} events[PERF_NCOUNTERS] = {
+	[PERF_CYCLES] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+	[PERF_INSTRUCTIONS] = { PERF_TYPE_HARDWARE,
+				PERF_COUNT_HW_INSTRUCTIONS },
+	[PERF_L1D_MISSES] = { PERF_TYPE_HW_CACHE,
+			      PERF_COUNT_HW_CACHE_L1D |
+			      PERF_COUNT_HW_CACHE_OP_READ << 8 |
+			      PERF_COUNT_HW_CACHE_RESULT_MISS << 16 },
+	[PERF_LLC_MISSES] = { PERF_TYPE_HARDWARE,
+			      PERF_COUNT_HW_CACHE_MISSES },
+	[PERF_BRANCH_MISSES] = { PERF_TYPE_HARDWARE,
+				 PERF_COUNT_HW_BRANCH_MISSES },
+};
+
+static int open_counter(int i)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = events[i].type;
+	attr.config = events[i].config;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+			   PERF_FORMAT_TOTAL_TIME_RUNNING;
+	/* User space only, which perf_event_paranoid 2 still allows */
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#else
+static int open_counter(int i)
+{
+	(void) i;
+	return -1;
+}
+#endif
+
+static int read_counter(int fd, struct perf_reading *r)
+{
+	uint64_t buf[3];
+
+	if (read(fd, buf, sizeof(buf)) != sizeof(buf))
+		return -1;
+
+	r->value = buf[0];
+	r->enabled = buf[1];
+	r->running = buf[2];
+	return 0;
+}
+
+int perf_counters_open(struct perf_counters *pf)
+{
+	int n = 0;
+
+	memset(pf, 0, sizeof(*pf));
+	for (int i = 0; i < PERF_NCOUNTERS; i++) {
+		pf->fd[i] = open_counter(i);
+		if (pf->fd[i] >= 0) {
+			pf->avail |= 1U << i;
+			n++;
+		}
+	}
+
+	return n;
+}
+
+void perf_counters_close(struct perf_counters *pf)
+{
+	for (int i = 0; i < PERF_NCOUNTERS; i++) {
+		if (pf->fd[i] >= 0)
+			close(pf->fd[i]);
+		pf->fd[i] = -1;
+	}
+}
+
+void perf_counters_start(struct perf_counters *pf)
+{
+	for (int i = 0; i < PERF_NCOUNTERS; i++) {
+		if (pf->fd[i] >= 0 && read_counter(pf->fd[i], &pf->start[i]))
+			pf->avail &= ~(1U << i);
+	}
+}
+
+void perf_counters_stop(struct perf_counters *pf)
+{
+	struct perf_reading r;
+
+	for (int i = 0; i < PERF_NCOUNTERS; i++) {
+		if (pf->fd[i] < 0)
+			continue;
+
+		if (read_counter(pf->fd[i], &r)) {
+			pf->avail &= ~(1U << i);
+			continue;
+		}
+
+		pf->sum[i].value += r.value - pf->start[i].value;
+		pf->sum[i].enabled += r.enabled - pf->start[i].enabled;
+		pf->sum[i].running += r.running - pf->start[i].running;
+	}
+}
+
+void perf_counters_add(struct perf_counters *pf,
+		       const struct perf_counters *src)
+{
+	pf->avail &= src->avail;
+	for (int i = 0; i < PERF_NCOUNTERS; i++) {
+		pf->sum[i].value += src->sum[i].value;
+		pf->sum[i].enabled += src->sum[i].enabled;
+		pf->sum[i].running += src->sum[i].running;
+	}
+}
+
+double perf_counters_value(const struct perf_counters *pf, int i)
+{
+	const struct perf_reading *s = &pf->sum[i];
+
+	if (!(pf->avail & 1U << i))
+		return NAN;
+
+	/* Never scheduled on the hardware, for want of counters */
+	if (s->enabled && !s->running)
+		return NAN;
+
+	if (s->running < s->enabled)
+		return (double) s->value * s->enabled / s->running;
+
+	return s->value;
+}
+
+void perf_counters_print_heads(FILE *file, const char *prefix, size_t first)
+{
+	static const char *const heads[] = {
+		"cycles per codeword",
+		"instructions per codeword",
+		"L1 data cache read misses per codeword",
+		"last level cache misses per codeword",
+		"branch misses per codeword",
+		"instructions per cycle",
+	};
+
+	for (size_t i = 0; i < sizeof(heads) / sizeof(heads[0]); i++)
+		fprintf(file, "%s(%zu) %s\n", prefix, first + i, heads[i]);
+}
+
+void perf_counters_print(FILE *file, const struct perf_counters *pf,
+			 size_t nwords)
+{
+	for (int i = 0; i < PERF_NCOUNTERS; i++)
+		fprintf(file, " %.1f", perf_counters_value(pf, i) / nwords);
+
+	fprintf(file, " %.3f", perf_counters_value(pf, PERF_INSTRUCTIONS) /
+		perf_counters_value(pf, PERF_CYCLES));
+}
@@ -0,0 +1,87 @@
+/*
+ * perf_counters.h
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+
+#ifndef FB_PCDECODE_PERF_COUNTERS_H
+#define FB_PCDECODE_PERF_COUNTERS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Hardware counters of the calling thread, in user space, read with
+ * perf_event_open around the code to measure. A counter that cannot be opened,
+ * because the kernel or the hardware lacks it, or because the container or
+ * perf_event_paranoid forbids it, is left out and reported as nan. Threads
+ * that the measured code starts, such as an OpenMP team, are not counted.
+ */
+enum perf_counter {
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_L1D_MISSES,	/* L1 data cache read misses */
+	PERF_LLC_MISSES,	/* last level cache misses */
+	PERF_BRANCH_MISSES,
+	PERF_NCOUNTERS
+};
+
+struct perf_reading {
+	uint64_t value;
+	uint64_t enabled;	/* ns, for scaling multiplexed counters */
+	uint64_t running;
+};
+
+struct perf_counters {
+	int fd[PERF_NCOUNTERS];
+	unsigned avail;		/* bit i: counter i was open in all of sum */
+	struct perf_reading start[PERF_NCOUNTERS];
+	struct perf_reading sum[PERF_NCOUNTERS];
+};
+
+/* Opens the counters for the calling thread and clears the sums. Returns the
+ * number of counters opened. */
+int perf_counters_open(struct perf_counters *pf);
+
+/* Closes the counters, keeping the sums */
+void perf_counters_close(struct perf_counters *pf);
+
+/* Measures from perf_counters_start to perf_counters_stop, adding the counts
+ * to the sums. Both must be called by the thread that opened the counters. */
+void perf_counters_start(struct perf_counters *pf);
+void perf_counters_stop(struct perf_counters *pf);
+
+/* Adds the sums of src to pf. A counter is available in the result only if it
+ * is in both. */
+void perf_counters_add(struct perf_counters *pf,
+		       const struct perf_counters *src);
+
+/* The sum of counter i, scaled up if the counter was multiplexed, or nan */
+double perf_counters_value(const struct perf_counters *pf, int i);
+
+/* Prints the heads of the columns of perf_counters_print, numbered from
+ * first */
+void perf_counters_print_heads(FILE *file, const char *prefix, size_t first);
+
+/* Prints the counts per word of nwords, and the instructions per cycle, as
+ * columns */
+void perf_counters_print(FILE *file, const struct perf_counters *pf,
+			 size_t nwords);
+
+#endif /* FB_PCDECODE_PERF_COUNTERS_H */
@@ -19,24 +19,217 @@
  * Written by Ferdinand Blomqvist.
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include "product_code.h"
+#include "pc_trace.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
-#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PC_TILE 32
+/* Rows per block when computing the row syndromes */
+#define PC_SYN_ROWS 64
+
+/* The auto decoder sorts words into buckets by the number of columns that
+ * fail in the first pass and the number of corrections made in it. Its
+ * default order is used for the first words of each bucket, and for every
+ * PC_AUTO_EXPLORE-th word after that, so that every decoder keeps being
+ * measured. The counts are halved once they reach PC_AUTO_WINDOW, so that
+ * the failure rates follow changes in the channel. */
+#define PC_AUTO_BUCKETS 16
+#define PC_AUTO_WARMUP 8
+#define PC_AUTO_EXPLORE 32
+#define PC_AUTO_WINDOW 1024
+
+/* The results of the line decoders of one pass */
+struct line_buf {
+	size_t n;		/* lines decoded in the pass */
+	size_t *idx;		/* the lines */
+	int *ret;		/* decoder result per line */
+	int *pos;		/* error positions, nroots per line */
+	uint16_t *val;		/* error values, nroots per line */
+};
+
+enum auto_seq {
+	AUTO_IEG,		/* iter, eras, gd */
+	AUTO_GIE		/* gd, iter, eras */
+};
+
+struct auto_bucket {
+	size_t words;
+	size_t iter, iter_fail;	/* words that iter got, and failed */
+	size_t eras, eras_fail;
+	size_t gd, gd_fail;
+};
+
+/* The cost model of pc_decode_auto */
+struct pc_auto {
+	/* Running averages of the time in seconds of the first column pass of
+	 * iter, of the rest of iter, of eras after iter and of gd. Zero until
+	 * measured. */
+	double t_first, t_rest, t_eras, t_gd;
+	double start, mark;	/* start and end of the first column pass */
+	enum auto_seq seq;	/* chosen for the current word */
+	uint16_t *word;		/* the received word, while gd goes first */
+	struct auto_bucket *cur;
+	struct auto_bucket b[PC_AUTO_BUCKETS][PC_AUTO_BUCKETS];
+};
 
 struct estrat {
 	int *strat;
 	size_t size;
 	int viable;
+	uint16_t *lambda;	/* erasure locator polynomial */
 };
 
+struct corr {
+	size_t pos;
+	uint16_t old;
+};
+
+static void line_buf_free(struct line_buf *lb)
+{
+	if (!lb)
+		return;
+
+	free(lb->val);
+	free(lb->pos);
+	free(lb->ret);
+	free(lb->idx);
+	free(lb);
+}
+
+/* Allocates room for the results of a pass over the lines of n words */
+static struct line_buf *line_buf_alloc(const struct pc *pc, size_t n)
+{
+	size_t r_nroots = pc->row_dec->nroots;
+	size_t c_nroots = pc->col_dec->nroots;
+	size_t nlines = pc->rows > pc->cols ? pc->rows : pc->cols;
+	size_t npos = pc->rows * r_nroots > pc->cols * c_nroots
+		      ? pc->rows * r_nroots : pc->cols * c_nroots;
+
+	struct line_buf *lb = calloc(1, sizeof(*lb));
+	if (!lb)
+		return NULL;
+
+	lb->idx = malloc(n * nlines * sizeof(*lb->idx));
+	lb->ret = malloc(n * nlines * sizeof(*lb->ret));
+	lb->pos = malloc(n * npos * sizeof(*lb->pos));
+	lb->val = malloc(n * npos * sizeof(*lb->val));
+	if (!lb->idx || !lb->ret || !lb->pos || !lb->val) {
+		line_buf_free(lb);
+		return NULL;
+	}
+
+	return lb;
+}
+
+static inline uint16_t sym_get(const struct pc *pc, const void *buf, size_t i)
+{
+	if (pc->symbytes == 1)
+		return ((const uint8_t *) buf)[i];
+	return ((const uint16_t *) buf)[i];
+}
+
+static inline void sym_set(const struct pc *pc, void *buf, size_t i,
+			   uint16_t val)
+{
+	if (pc->symbytes == 1)
+		((uint8_t *) buf)[i] = val;
+	else
+		((uint16_t *) buf)[i] = val;
+}
+
+static inline void sym_xor(const struct pc *pc, void *buf, size_t i,
+			   uint16_t val)
+{
+	if (pc->symbytes == 1)
+		((uint8_t *) buf)[i] ^= val;
+	else
+		((uint16_t *) buf)[i] ^= val;
+}
+
+/* Copies n symbols from src into the working copy dst */
+static void sym_load(const struct pc *pc, void *dst, const uint16_t *src,
+		     size_t n)
+{
+	if (pc->symbytes == 1) {
+		uint8_t *d = dst;
+		for (size_t i = 0; i < n; i++)
+			d[i] = src[i];
+	} else {
+		memcpy(dst, src, n * sizeof(*src));
+	}
+}
+
+/* Copies n symbols from the working copy src into dst */
+static void sym_store(const struct pc *pc, uint16_t *dst, const void *src,
+		      size_t n)
+{
+	if (pc->symbytes == 1) {
+		const uint8_t *s = src;
+		for (size_t i = 0; i < n; i++)
+			dst[i] = s[i];
+	} else {
+		memcpy(dst, src, n * sizeof(*dst));
+	}
+}
+
+/* rsdec_syndrome on the word in the working copy buf, starting at symbol off */
+static void sym_syndrome(const struct pc *pc, const struct rsdec *rs,
+			 const void *buf, size_t off, size_t len,
+			 size_t stride, uint16_t *syn)
+{
+	if (pc->symbytes == 1)
+		rsdec_syndrome8(rs, (const uint8_t *) buf + off, len,
+				stride, syn);
+	else
+		rsdec_syndrome(rs, (const uint16_t *) buf + off, len,
+			       stride, syn);
+}
+
+/* rsdec_syndrome_interleaved on the working copy buf, from symbol off */
+static void sym_syndrome_interleaved(const struct pc *pc,
+				     const struct rsdec *rs, const void *buf,
+				     size_t off, size_t len, size_t n,
+				     uint16_t *syn)
+{
+	if (pc->symbytes == 1)
+		rsdec_syndrome_interleaved8(rs, (const uint8_t *) buf + off,
+					    len, n, syn);
+	else
+		rsdec_syndrome_interleaved(rs, (const uint16_t *) buf + off,
+					   len, n, syn);
+}
+
+/* rsdec_syndrome_words on the n words of length len in the working copy buf,
+ * starting at symbol off */
+static void sym_syndrome_words(const struct pc *pc, const struct rsdec *rs,
+			       const void *buf, size_t off, size_t len,
+			       size_t n, uint16_t *syn)
+{
+	if (pc->symbytes == 1) {
+		rsdec_syndrome_words8(rs, (const uint8_t *) buf + off, len,
+				      n, syn);
+		return;
+	}
+
+	for (size_t i = 0; i < n; i++)
+		rsdec_syndrome(rs, (const uint16_t *) buf + off + i * len, len,
+			       1, syn + i * rs->nroots);
+}
+
 size_t get_gfpoly(size_t symsize)
 {
 	static size_t gfpolys[] = {
 		0x7,	0xb,	0x13,	0x25,	0x43,
 		0x89,	0x11d,	0x211,	0x409,	0x805,
-		0x1053,	0x201b,	0x4443,	0x8003,	0x1100
+		0x1053,	0x201b,	0x4443,	0x8003,	0x1100b
 	};
 
 	return gfpolys[symsize - 2];
@@ -62,6 +255,14 @@ struct pc *pc_init(size_t symsize, size_t gfpoly,
 	if (!pc->col_code)
 		goto err;
 
+	pc->row_dec = rsdec_init(symsize, gfpoly, r_fcr, r_prim, r_nroots);
+	if (!pc->row_dec)
+		goto err;
+
+	pc->col_dec = rsdec_init(symsize, gfpoly, c_fcr, c_prim, c_nroots);
+	if (!pc->col_dec)
+		goto err;
+
 	pc->nstrat = (rs_mind(pc->col_code) + 1) / 2;
 	pc->es = malloc(pc->nstrat * sizeof(*pc->es));
 	if (!pc->es)
@@ -72,25 +273,88 @@ struct pc *pc_init(size_t symsize, size_t gfpoly,
 	if (!pc->es_buffer)
 		goto err;
 
-	for (size_t i = 0; i < pc->nstrat; i++)
+	pc->es_lambda = malloc(pc->nstrat * (slen + 1) * sizeof(*pc->es_lambda));
+	if (!pc->es_lambda)
+		goto err;
+
+	for (size_t i = 0; i < pc->nstrat; i++) {
 		pc->es[i].strat = pc->es_buffer + (i * slen);
+		pc->es[i].lambda = pc->es_lambda + (i * (slen + 1));
+	}
 
-	pc->x_buf = malloc(2 * rows * cols * sizeof(*pc->x_buf));
+	pc->x_buf = malloc(rows * cols * sizeof(*pc->x_buf));
 	if (!pc->x_buf)
 		goto err;
 
-	pc->y_buf = pc->x_buf + rows * cols;
 	pc->rows = rows;
 	pc->cols = cols;
 
+	pc->symbytes = symsize <= 8 ? 1 : 2;
+	pc->w_buf = malloc(rows * cols * pc->symbytes);
+	if (!pc->w_buf)
+		goto err;
+
+	size_t nsyn = rows * r_nroots + cols * c_nroots;
+	pc->row_syn = malloc(nsyn * sizeof(*pc->row_syn));
+	if (!pc->row_syn)
+		goto err;
+
+	pc->col_syn = pc->row_syn + rows * r_nroots;
+
+	/* Every line is decoded at most once per round */
+	pc->log = malloc(nsyn * sizeof(*pc->log));
+	if (!pc->log)
+		goto err;
+
+	pc->lines = line_buf_alloc(pc, 1);
+	pc->first = line_buf_alloc(pc, 1);
+	if (!pc->lines || !pc->first)
+		goto err;
+
+	pc->col_dirty = malloc(2 * (rows + cols));
+	if (!pc->col_dirty)
+		goto err;
+
+	pc->row_dirty = pc->col_dirty + cols;
+	pc->col_fail = pc->row_dirty + rows;
+	pc->row_fail = pc->col_fail + cols;
+
+	pc->autos = calloc(1, sizeof(*pc->autos));
+	if (!pc->autos)
+		goto err;
+
+	pc->autos->word = malloc(rows * cols * sizeof(*pc->autos->word));
+	if (!pc->autos->word)
+		goto err;
+
 	size_t tmp = (rs_mind(pc->row_code) + 1) / 2;
 	pc->nstrat_bound = tmp < pc->nstrat ? tmp : pc->nstrat;
 
+	if (pc_set_layout(pc, PC_LAYOUT_AUTO))
+		goto err;
+
+	if (pc_set_threads(pc, 1))
+		goto err;
+
 	return pc;
 
 err:
+	if (pc->autos)
+		free(pc->autos->word);
+	free(pc->autos);
+	free(pc->col_dirty);
+	free(pc->t_buf);
+	line_buf_free(pc->first);
+	line_buf_free(pc->lines);
+	free(pc->log);
+	free(pc->row_syn);
+	free(pc->w_buf);
+	free(pc->x_buf);
+	free(pc->es_lambda);
 	free(pc->es_buffer);
 	free(pc->es);
+	rsdec_free(pc->col_dec);
+	rsdec_free(pc->row_dec);
 	rs_free(pc->col_code);
 	rs_free(pc->row_code);
 	free(pc);
@@ -102,23 +366,269 @@ void pc_free(struct pc *pc)
 	if (!pc)
 		return;
 
+	free(pc->eras_left);
+	free(pc->autos->word);
+	free(pc->autos);
+	free(pc->col_dirty);
+	line_buf_free(pc->first);
+	line_buf_free(pc->lines);
+	free(pc->log);
+	free(pc->row_syn);
+	free(pc->t_buf);
+	free(pc->w_buf);
 	free(pc->x_buf);
+	free(pc->es_lambda);
 	free(pc->es_buffer);
 	free(pc->es);
+	rsdec_free(pc->col_dec);
+	rsdec_free(pc->row_dec);
 	rs_free(pc->col_code);
 	rs_free(pc->row_code);
 	free(pc);
 }
 
+struct pc *pc_clone(const struct pc *pc)
+{
+	const struct rsdec *r = pc->row_dec;
+	const struct rsdec *c = pc->col_dec;
+
+	struct pc *clone = pc_init(r->mm, r->gfpoly,
+				   r->fcr, r->prim, r->nroots,
+				   c->fcr, c->prim, c->nroots,
+				   pc->rows, pc->cols);
+	if (!clone)
+		return NULL;
+
+	enum pc_layout layout = pc->t_buf ? PC_LAYOUT_TRANSPOSED
+					  : PC_LAYOUT_STRIDED;
+	if (pc_set_layout(clone, layout)) {
+		pc_free(clone);
+		return NULL;
+	}
+
+	return clone;
+}
+
+/* Whether the lines touched by a strided column pass overflow L1 */
+static int column_spills_l1(const struct pc *pc)
+{
+	long l1 = -1, line = -1;
+
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+	l1 = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+	line = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+#endif
+	if (l1 <= 0)
+		l1 = PC_L1_SIZE;
+	if (line <= 0)
+		line = PC_LINE_SIZE;
+
+	/* When a whole row fits in a line the strided word is already as
+	 * compact as the transposed copy */
+	if (pc->cols * pc->symbytes <= (size_t)line)
+		return 0;
+
+	return pc->rows * line >= (size_t)l1;
+}
+
+int pc_set_layout(struct pc *pc, enum pc_layout layout)
+{
+	if (layout == PC_LAYOUT_AUTO)
+		layout = column_spills_l1(pc)
+			 ? PC_LAYOUT_TRANSPOSED : PC_LAYOUT_STRIDED;
+
+	if (layout == PC_LAYOUT_STRIDED) {
+		free(pc->t_buf);
+		pc->t_buf = NULL;
+	} else if (!pc->t_buf) {
+		pc->t_buf = malloc(pc_len(pc) * pc->symbytes);
+		if (!pc->t_buf)
+			return -1;
+	}
+
+	return 0;
+}
+
+int pc_set_erasures(struct pc *pc, const uint8_t *eras)
+{
+	if (eras && !pc->eras_left) {
+		size_t len = pc_len(pc);
+		size_t nlines = pc->rows + pc->cols;
+
+		/* The counts go after the flags, aligned for ints */
+		len = (len + sizeof(int) - 1) / sizeof(int) * sizeof(int);
+		pc->eras_left = malloc(len + nlines * sizeof(int));
+		if (!pc->eras_left)
+			return -1;
+
+		pc->col_neras = (int *) (pc->eras_left + len);
+		pc->row_neras = pc->col_neras + pc->cols;
+	}
+
+	pc->chan_eras = eras;
+	return 0;
+}
+
+int pc_set_threads(struct pc *pc, int nthreads)
+{
+	if (nthreads < 1)
+		nthreads = 1;
+
+	pc->nthreads = nthreads;
+	return 0;
+}
+
+/* The columns are encoded together in one pass over the rows, and then the
+ * rows in blocks, instead of one LFSR walk per column and row. */
 void pc_encode(struct pc *pc, uint16_t *data)
 {
-	size_t row_dlen = pc->cols - pc->row_code->nroots;
-	for (size_t i = 0; i < row_dlen; i++)
-		rs_encode(pc->col_code, &data[i], pc->rows, pc->cols);
+	size_t row_dlen = pc->cols - pc->row_dec->nroots;
+
+	rsdec_encode_interleaved(pc->col_dec, data, pc->rows, row_dlen,
+				 pc->cols);
+	rsdec_encode_words(pc->row_dec, data, pc->cols, pc->rows);
+}
+
+/* The rows are checked first, one at a time, so that most words that are not
+ * codewords are rejected early. */
+int pc_check(struct pc *pc, const uint16_t *data)
+{
+	struct rsdec *rs_r = pc->row_dec;
+	struct rsdec *rs_c = pc->col_dec;
+	uint16_t syn[rs_r->nroots];
+
+	for (size_t i = 0; i < pc->rows; i++) {
+		rsdec_syndrome(rs_r, data + i * pc->cols, pc->cols, 1, syn);
+		if (!rsdec_syn_zero(rs_r, syn))
+			return 0;
+	}
+
+	rsdec_syndrome_interleaved(rs_c, data, pc->rows, pc->cols, pc->col_syn);
+	for (size_t i = 0; i < pc->cols; i++)
+		if (!rsdec_syn_zero(rs_c, &pc->col_syn[i * rs_c->nroots]))
+			return 0;
+
+	return 1;
+}
+
+static void transpose_tile(const struct pc *pc, void *t, const uint16_t *y,
+			   size_t rb, size_t rend, size_t cb, size_t cend)
+{
+	if (pc->symbytes == 1) {
+		uint8_t *t8 = t;
+		for (size_t c = cb; c < cend; c++)
+			for (size_t r = rb; r < rend; r++)
+				t8[c * pc->rows + r] = y[r * pc->cols + c];
+	} else {
+		uint16_t *t16 = t;
+		for (size_t c = cb; c < cend; c++)
+			for (size_t r = rb; r < rend; r++)
+				t16[c * pc->rows + r] = y[r * pc->cols + c];
+	}
+}
+
+/* Copies the word y into the transposed working copy tile by tile, so that
+ * both the reads and the writes stay within a few cache lines at a time. */
+static void col_pass_begin(struct pc *pc, const uint16_t *y)
+{
+	if (!pc->t_buf)
+		return;
+
+	#pragma omp parallel for num_threads(pc->nthreads) if (pc->nthreads > 1)
+	for (size_t rb = 0; rb < pc->rows; rb += PC_TILE) {
+		size_t rend = rb + PC_TILE < pc->rows ? rb + PC_TILE : pc->rows;
+		for (size_t cb = 0; cb < pc->cols; cb += PC_TILE) {
+			size_t cend = cb + PC_TILE < pc->cols ? cb + PC_TILE : pc->cols;
+			transpose_tile(pc, pc->t_buf, y, rb, rend, cb, cend);
+		}
+	}
+}
+
+static inline int chan_erased(const struct pc *pc, size_t pos)
+{ return pc->chan_eras[pos >> 3] >> (pos & 7) & 1; }
+
+/* Stores the rows of the symbols of column i flagged by the channel in pos
+ * and returns their number, or zero if there are more than the column code
+ * can take, in which case the column is decoded without them. */
+static int col_chan_eras(const struct pc *pc, size_t i, int *pos)
+{
+	int nroots = pc->col_dec->nroots;
+	int n = 0;
+
+	for (size_t r = 0; r < pc->rows; r++) {
+		if (!chan_erased(pc, r * pc->cols + i))
+			continue;
+		if (n == nroots)
+			return 0;
+		pos[n++] = r;
+	}
 
-	uint16_t *end = data + pc_len(pc);
-	for (uint16_t *ptr = data; ptr < end; ptr += pc->cols)
-		rs_encode(pc->row_code, ptr, pc->cols, 1);
+	return n;
+}
+
+/* Counts the errors, i.e., the corrections that were not at erasures, of the
+ * n corrections of column i at the rows in errpos */
+static int col_errors(const struct pc *pc, size_t i, const int *errpos,
+		      int n, int neras)
+{
+	int e = n;
+
+	if (n > 0 && neras)
+		for (int j = 0; j < n; j++)
+			e -= chan_erased(pc, errpos[j] * pc->cols + i);
+
+	return e;
+}
+
+/* Decodes column i of y with the channel erasures in it, if any. With the
+ * transposed layout the syndromes are computed from the contiguous working
+ * copy. Only the corrected symbols are written to y, so different columns
+ * can be decoded concurrently. Returns the number of errors corrected, or -1,
+ * and stores the number of erasures in neras. */
+static int decode_col(struct pc *pc, uint16_t *y, size_t i, int *neras)
+{
+	struct rsdec *rs = pc->col_dec;
+	uint16_t syn[rs->nroots], errval[rs->nroots];
+	int errpos[rs->nroots], eras[rs->nroots];
+
+	if (pc->t_buf)
+		sym_syndrome(pc, rs, pc->t_buf, i * pc->rows, pc->rows, 1, syn);
+	else
+		rsdec_syndrome(rs, &y[i], pc->rows, pc->cols, syn);
+
+	*neras = pc->chan_eras ? col_chan_eras(pc, i, eras) : 0;
+	int ret = rsdec_decode(rs, syn, pc->rows, eras, *neras, errpos, errval);
+	for (int j = 0; j < ret; j++)
+		y[errpos[j] * pc->cols + i] ^= errval[j];
+
+	return col_errors(pc, i, errpos, ret, *neras);
+}
+
+/* Applies the corrections of the first column pass of iter, kept by
+ * keep_first_pass, to y and stores the result of each column in ret and
+ * neras, as decode_col does. This is what decoding the columns of the same
+ * received word would give. */
+static void apply_first_pass(struct pc *pc, uint16_t *y, int *ret,
+			     int *neras)
+{
+	const struct line_buf *lb = pc->first;
+	int nroots = pc->col_dec->nroots;
+	int eras[nroots];
+
+	memset(ret, 0, pc->cols * sizeof(*ret));
+	memset(neras, 0, pc->cols * sizeof(*neras));
+	for (size_t k = 0; k < lb->n; k++) {
+		size_t i = lb->idx[k];
+		const int *pos = lb->pos + k * nroots;
+		const uint16_t *val = lb->val + k * nroots;
+
+		for (int j = 0; j < lb->ret[k]; j++)
+			y[pos[j] * pc->cols + i] ^= val[j];
+
+		if (pc->chan_eras)
+			neras[i] = col_chan_eras(pc, i, eras);
+		ret[i] = col_errors(pc, i, pos, lb->ret[k], neras[i]);
+	}
 }
 
 static void reset_estrat(struct pc *pc)
@@ -192,110 +702,243 @@ static size_t estrat_count_viable(struct pc *pc)
 	return w;
 }
 
-static inline double calc_weight(int e, int t, size_t d)
-{ return e < 0 || e > t ? 0 : ((double) d - 2 * e) / d; }
+/* The strategies stay fixed for the rest of the codeword, so the erasure
+ * locators are computed once here instead of once per row and strategy. */
+static void estrat_compute_locators(struct pc *pc)
+{
+	for (size_t i = 0; i < pc->nstrat; i++) {
+		struct estrat *es = &pc->es[i];
+		if (es->viable)
+			rsdec_eras_locator(pc->row_dec, pc->cols, es->strat,
+					   es->size, es->lambda);
+	}
+}
 
-static void decode_columns_gmd(struct pc *pc, uint16_t *data, double *weights)
+/* The reliability (d - 2e - f) / d of a column decoded with e errors and f
+ * erasures, scaled by d to an integer. A known erasure uses up half the
+ * distance that an error does. */
+static inline int calc_weight(int e, int f, size_t d)
+{ return e < 0 || 2 * e + f >= (int) d ? 0 : (int) d - 2 * e - f; }
+
+/* Decodes the columns of data, or takes them from the first pass of iter if
+ * reuse is set, and sets up the erasure strategies and the weights. A column
+ * goes into one strategy for each error corrected in it, and one for every
+ * two erasures, rounded up, so that the columns are erased in the order of
+ * their weights. */
+static void decode_columns_gmd(struct pc *pc, uint16_t *data, int *weights,
+			       int reuse, struct stats *s)
 {
-	struct rs_code *rs = pc->col_code;
+	struct rsdec *rs = pc->col_dec;
 	size_t d = rs->nroots + 1;
-	int t = rs->nroots / 2;
+
+	int ret[pc->cols], neras[pc->cols];
 
 	reset_estrat(pc);
+	if (reuse) {
+		apply_first_pass(pc, data, ret, neras);
+	} else {
+		col_pass_begin(pc, data);
+
+		#pragma omp parallel for num_threads(pc->nthreads) \
+			if (pc->nthreads > 1)
+		for (size_t i = 0; i < pc->cols; i++)
+			ret[i] = decode_col(pc, data, i, &neras[i]);
+
+		PC_STAT(s, cdec, pc->cols);
+	}
 
 	for (size_t i = 0; i < pc->cols; i++) {
-		int ret = rs_decode(rs, &data[i], pc->rows,
-				    pc->cols, NULL, 0, NULL);
-		add_to_estrat(pc, i, ret);
-		weights[i] = calc_weight(ret, t, d);
+		add_to_estrat(pc, i, ret[i] < 0 ? ret[i]
+					       : ret[i] + (neras[i] + 1) / 2);
+		weights[i] = calc_weight(ret[i], neras[i], d);
 	}
 
 	estrat_disable_duplicates(pc);
 	estrat_remove_unnecessary(pc);
+	estrat_compute_locators(pc);
+}
+
+/*
+ * The generalized distance of a candidate row is the sum over the columns of
+ * 1 - w if the candidate agrees with the row and 1 + w if it does not, where
+ * w is the weight of the column. Scaled by the column distance d, as the
+ * weights are, this is the baseline len * d - sum(w), which is the same for
+ * every candidate, plus 2 * w for each position the candidate corrects.
+ */
+static long gdm_baseline(const struct pc *pc, const int *weights)
+{
+	long sum = (long) pc->cols * (pc->col_dec->nroots + 1);
+
+	for (size_t i = 0; i < pc->cols; i++)
+		sum -= weights[i];
+
+	return sum;
+}
+
+static inline long calc_gdm(long base, const int *weights,
+			    const int *errpos, int nerr)
+{
+	for (int i = 0; i < nerr; i++)
+		base += 2 * weights[errpos[i]];
+
+	return base;
 }
 
-static double calc_gdm(const double *weights, size_t len,
-		       const int *errpos, int nerr)
+/* A candidate is accepted if its distance is less than the row distance */
+static inline long gdm_bound(const struct pc *pc)
+{ return (long) (pc->row_dec->nroots + 1) * (pc->col_dec->nroots + 1); }
+
+/*
+ * Returns nonzero if the candidate with the corrections at errpos is within
+ * the bound. A candidate at exactly the bound is decided by the unscaled
+ * distance summed in doubles over the columns in order, as it always was,
+ * which comes out on either side of the bound depending on rounding.
+ */
+static int gdm_accept(const struct pc *pc, long base, const int *weights,
+		      const int *errpos, int nerr)
 {
-	uint16_t errs[len];
+	long dist = calc_gdm(base, weights, errpos, nerr);
+
+	if (dist != gdm_bound(pc))
+		return dist < gdm_bound(pc);
 
-	memset(errs, 0, len * sizeof(*errs));
+	double d = pc->col_dec->nroots + 1;
+	char errs[pc->cols];
+
+	memset(errs, 0, sizeof(errs));
 	for (int i = 0; i < nerr; i++)
 		errs[errpos[i]] = 1;
 
-	double sum = len;
-	for (size_t i = 0; i < len; i++)
-		sum += errs[i] ? weights[i] : -weights[i];
+	double sum = pc->cols;
+	for (size_t i = 0; i < pc->cols; i++)
+		sum += errs[i] ? weights[i] / d : -weights[i] / d;
 
-	return sum;
+	return sum < pc->row_dec->nroots + 1;
+}
+
+/* Sets row r of data to row r of x with the n corrections in errpos and
+ * errval applied */
+static void set_row(struct pc *pc, uint16_t *data, const uint16_t *x,
+		    size_t r, const int *errpos, const uint16_t *errval, int n)
+{
+	uint16_t *row = data + r * pc->cols;
+
+	memcpy(row, x + r * pc->cols, pc->cols * sizeof(*row));
+	for (int j = 0; j < n; j++)
+		row[errpos[j]] ^= errval[j];
 }
 
 static size_t update_stats_and_check_if_viable(struct pc *pc,
 					       struct stats *s, int gmd)
 {
 	size_t viable = estrat_count_viable(pc);
-	s->viable += viable;
-	s->cdec += pc->cols;
-	s->max += pc->nstrat_bound;
+	PC_STAT(s, viable, viable);
+	PC_STAT(s, max, pc->nstrat_bound);
 	if (gmd)
-		s->rdec_max += (pc->nstrat_bound - 1) + pc->rows;
+		PC_STAT(s, rdec_max, (pc->nstrat_bound - 1) + pc->rows);
 	else
-		s->rdec_max += pc->nstrat_bound * pc->rows;
+		PC_STAT(s, rdec_max, pc->nstrat_bound * pc->rows);
 
 	return viable;
 }
 
+/*
+ * Brings the Forney syndromes fsyn of a row from the strategy from to the
+ * strategy to. The strategies are nested, so only the erasures of to that are
+ * not in from need to be added. If from is NULL, fsyn is computed from the
+ * syndromes syn of the row.
+ */
+static void estrat_forney_syndromes(struct pc *pc, const struct estrat *from,
+				    const struct estrat *to,
+				    const uint16_t *syn, uint16_t *fsyn)
+{
+	struct rsdec *rs = pc->row_dec;
+
+	if (!from) {
+		rsdec_forney_syndromes(rs, syn, to->lambda, fsyn);
+		return;
+	}
+
+	int delta[to->size];
+	int n = 0;
+	for (size_t i = 0, j = 0; i < to->size; i++) {
+		if (j < from->size && from->strat[j] == to->strat[i])
+			j++;
+		else
+			delta[n++] = to->strat[i];
+	}
+
+	rsdec_forney_add_erasures(rs, fsyn, pc->cols, delta, n);
+}
+
+/* Decodes a row from its Forney syndromes for the strategy es. The row is
+ * left as it is; the candidate is given by the corrections in errors and
+ * errval. */
+static int decode_row_estrat(struct pc *pc, const uint16_t *fsyn,
+			     struct estrat *es, int *errors, uint16_t *errval)
+{
+	return rsdec_decode_forney(pc->row_dec, fsyn, pc->cols, es->strat,
+				   es->lambda, es->size, errors, errval);
+}
+
 /* Returns zero on success and 1 on failure */
 static int gmd_decode_row(struct pc *pc, int r, int *i, uint16_t *data,
-			  uint16_t *x, double *weights, struct stats *s)
+			  uint16_t *x, const int *weights, long base,
+			  struct stats *s)
 {
-	struct rs_code *rs = pc->row_code;
-	uint16_t *y = pc->y_buf;
+	struct rsdec *rs = pc->row_dec;
+	uint16_t syn[rs->nroots], fsyn[rs->nroots], errval[rs->nroots];
+	struct estrat *prev = NULL;
 	int errors[rs->nroots];
 	int fail = 1;
 
+	rsdec_syndrome(rs, x + r * pc->cols, pc->cols, 1, syn);
+
 	for (; *i >= 0; (*i)--) {
 		struct estrat *es = &pc->es[*i];
 
 		if (!es->viable)
 			continue;
 
-		// Copy row before decoding
-		memcpy(y, x + r * pc->cols, pc->cols * sizeof(*x));
-		s->rdec++;
+		estrat_forney_syndromes(pc, prev, es, syn, fsyn);
+		prev = es;
 
-		int ret = rs_decode(rs, y, pc->cols, 1,
-				    es->strat, es->size, errors);
+		PC_STAT(s, rdec, 1);
+		int ret = decode_row_estrat(pc, fsyn, es, errors, errval);
 		if (ret < 0)
 			continue;
 
-		double dist = calc_gdm(weights, pc->cols, errors, ret);
-		if (dist < rs->nroots + 1) {
-			memcpy(data + r * pc->cols, y, pc->cols * sizeof(*y));
+		if (gdm_accept(pc, base, weights, errors, ret)) {
+			set_row(pc, data, x, r, errors, errval, ret);
+			PC_TRACE(gmd_strategy, r, *i, ret);
 			fail = 0;
 			break;
 		}
 	}
 
+	if (fail)
+		PC_TRACE(gmd_strategy, r, -1, 0);
+
 	return fail;
 }
 
 int pc_decode_gmd(struct pc *pc, uint16_t *data, struct stats *s)
 {
-	double weights[pc->cols];
+	int weights[pc->cols];
 	uint16_t *x = pc->x_buf;
 
 	memcpy(x, data, pc_len(pc) * sizeof(*x));
-	decode_columns_gmd(pc, x, weights);
+	decode_columns_gmd(pc, x, weights, 0, s);
 
 	size_t viable = update_stats_and_check_if_viable(pc, s, 1);
 	if (viable == 0)
 		return -1;
 
+	long base = gdm_baseline(pc, weights);
 	int i = pc->nstrat - 1;
 
 	for (size_t r = 0; r < pc->rows; r++) {
-		int fail = gmd_decode_row(pc, r, &i, data, x, weights, s);
+		int fail = gmd_decode_row(pc, r, &i, data, x, weights, base, s);
 		if (fail)
 			return -1;
 	}
@@ -303,15 +946,19 @@ int pc_decode_gmd(struct pc *pc, uint16_t *data, struct stats *s)
 	return 0;
 }
 
-static void gd_decode_row(struct pc *pc, int r, uint16_t *data,
-			  uint16_t *x, double *weights, struct stats *s)
+/* Decodes row r into data. Returns the number of row decoder calls. */
+static size_t gd_decode_row(struct pc *pc, int r, uint16_t *data,
+			    const uint16_t *x, const int *weights, long base)
 {
-	struct rs_code *rs = pc->row_code;
-	uint16_t *y = pc->y_buf;
-	uint16_t *tmp = y + pc->cols;
-	double min_dist = INFINITY;
-	int errors[rs->nroots];
-	int fail = 1;
+	struct rsdec *rs = pc->row_dec;
+	size_t rdec = 0;
+	uint16_t syn[rs->nroots], fsyn[rs->nroots];
+	uint16_t errval[rs->nroots], keep_val[rs->nroots];
+	struct estrat *prev = NULL;
+	int errors[rs->nroots], keep_pos[rs->nroots];
+	int nkeep = 0;
+
+	rsdec_syndrome(rs, x + r * pc->cols, pc->cols, 1, syn);
 
 	for (int i = pc->nstrat - 1; i >= 0; i--) {
 		struct estrat *es = &pc->es[i];
@@ -319,182 +966,694 @@ static void gd_decode_row(struct pc *pc, int r, uint16_t *data,
 		if (!es->viable)
 			continue;
 
-		// Copy row before decoding
-		memcpy(y, x + r * pc->cols, pc->cols * sizeof(*x));
-		s->rdec++;
+		estrat_forney_syndromes(pc, prev, es, syn, fsyn);
+		prev = es;
 
-		int ret = rs_decode(rs, y, pc->cols, 1,
-				    es->strat, es->size, errors);
+		rdec++;
+		int ret = decode_row_estrat(pc, fsyn, es, errors, errval);
 		if (ret < 0)
 			continue;
 
-		double dist = calc_gdm(weights, pc->cols, errors, ret);
-		if (dist < rs->nroots + 1) {
-			memcpy(data + r * pc->cols, y, pc->cols * sizeof(*y));
-			fail = 0;
+		/* A row with no candidate within the bound gets the last
+		 * candidate that decoded, as the decoder always did. Only a
+		 * row that no strategy decodes at all stays as it is. */
+		memcpy(keep_pos, errors, ret * sizeof(*errors));
+		memcpy(keep_val, errval, ret * sizeof(*errval));
+		nkeep = ret;
+
+		if (gdm_accept(pc, base, weights, errors, ret))
 			break;
-		} else if (dist < min_dist) {
-			memcpy(tmp, y, pc->cols * sizeof(*y));
-		}
 	}
 
-	if (fail)
-		memcpy(data + r * pc->cols, tmp, pc->cols * sizeof(*y));
+	set_row(pc, data, x, r, keep_pos, keep_val, nkeep);
+	return rdec;
 }
 
-int pc_decode_gd(struct pc *pc, uint16_t *data, struct stats *s)
+/* GD decoding. If reuse is set, the last call of iter was on the same data,
+ * and its first column pass is used instead of decoding the columns again. */
+static int gd_decode(struct pc *pc, uint16_t *data, struct stats *s,
+		     int reuse)
 {
-	double weights[pc->cols];
+	int weights[pc->cols];
 	uint16_t *x = pc->x_buf;
 
 	memcpy(x, data, pc_len(pc) * sizeof(*x));
-	decode_columns_gmd(pc, x, weights);
+	decode_columns_gmd(pc, x, weights, reuse, s);
 
 	size_t viable = update_stats_and_check_if_viable(pc, s, 0);
 	if (viable == 0)
 		return -1;
 
+	long base = gdm_baseline(pc, weights);
+
+	/* The rows are independent and only write their own row of data */
+	size_t rdec = 0;
+	#pragma omp parallel for num_threads(pc->nthreads) if (pc->nthreads > 1) \
+		reduction(+:rdec) schedule(dynamic)
 	for (size_t r = 0; r < pc->rows; r++)
-		gd_decode_row(pc, r, data, x, weights, s);
+		rdec += gd_decode_row(pc, r, data, x, weights, base);
 
+	PC_STAT(s, rdec, rdec);
 	return 0;
 }
 
-int pc_decode_iter(struct pc *pc, uint16_t *data, struct stats *s)
-{
-	struct rs_code *rs_c = pc->col_code;
-	struct rs_code *rs_r = pc->row_code;
-	size_t len = pc_len(pc);
-	uint16_t *prev = pc->x_buf;
-	uint16_t *y = pc->y_buf;
-	size_t rounds = 0;
-	int fail;
-
-	memcpy(y, data, len * sizeof(*y));
+int pc_decode_gd(struct pc *pc, uint16_t *data, struct stats *s)
+{ return gd_decode(pc, data, s, 0); }
 
-	do {
-		memcpy(prev, y, len * sizeof(*y));
-		rounds++;
-		fail = 0;
+/* Computes the syndromes of all rows and columns of y */
+static void compute_syndromes(struct pc *pc, const void *y)
+{
+	struct rsdec *rs_r = pc->row_dec;
 
-		// Decode columns
-		for (size_t i = 0; i < pc->cols; i++) {
-			fail |= rs_decode(rs_c, &y[i], pc->rows,
-					  pc->cols, NULL, 0, NULL);
-		}
+	#pragma omp parallel for num_threads(pc->nthreads) if (pc->nthreads > 1)
+	for (size_t i = 0; i < pc->rows; i += PC_SYN_ROWS) {
+		size_t n = pc->rows - i < PC_SYN_ROWS ? pc->rows - i : PC_SYN_ROWS;
+		sym_syndrome_words(pc, rs_r, y, i * pc->cols, pc->cols, n,
+				   &pc->row_syn[i * rs_r->nroots]);
+	}
 
-		// Decode rows
-		uint16_t *end = y + len;
-		for (uint16_t *ptr = y; ptr < end; ptr += pc->cols) {
-			fail |= rs_decode(rs_r, ptr, pc->cols,
-					  1, NULL, 0, NULL);
-		}
-	} while (memcmp(y, prev, len * sizeof(*y)) != 0);
+	sym_syndrome_interleaved(pc, pc->col_dec, y, 0, pc->rows,
+				 pc->cols, pc->col_syn);
+}
 
-	if (!fail)
-		memcpy(data, y, len * sizeof(*y));
+static inline uint16_t *row_syn(struct pc *pc, size_t i)
+{ return &pc->row_syn[i * pc->row_dec->nroots]; }
 
-	s->cdec += pc->cols * rounds;
-	s->rdec += pc->rows * rounds;
-	return fail;
-}
+static inline uint16_t *col_syn(struct pc *pc, size_t i)
+{ return &pc->col_syn[i * pc->col_dec->nroots]; }
 
-int pc_decode_eras(struct pc *pc, uint16_t *data, struct stats *s)
+/* Applies the error value val at row r and column c of y, logs the old value
+ * of the symbol and updates the syndromes of the row and the column. */
+static void apply_corr(struct pc *pc, void *y, size_t r, size_t c,
+		       uint16_t val, size_t *nlog)
 {
-	int ret = pc_decode_iter(pc, data, s);
-	if (!ret)
-		return ret;
+	size_t pos = r * pc->cols + c;
 
-	s->alg2++;
+	pc->log[*nlog].pos = pos;
+	pc->log[(*nlog)++].old = sym_get(pc, y, pos);
+	sym_xor(pc, y, pos, val);
 
-	struct rs_code *rs_c = pc->col_code;
-	struct rs_code *rs_r = pc->row_code;
-	size_t len = pc_len(pc);
-	uint16_t *prev = pc->x_buf;
-	uint16_t *y = pc->y_buf;
-	size_t rounds = 1;
-	int fail;
-	int col_eras[pc->cols], col_eras_idx[pc->cols];
-	int row_eras[pc->cols], row_eras_idx[pc->cols];
-	int col_eras_count = 0;
-	int row_eras_count = 0;
+	rsdec_syn_update(pc->row_dec, row_syn(pc, r), pc->cols, c, val);
+	rsdec_syn_update(pc->col_dec, col_syn(pc, c), pc->rows, r, val);
+}
 
-	// Decode columns
-	for (size_t i = 0; i < pc->cols; i++) {
-		col_eras[i] = rs_decode(rs_c, &y[i], pc->rows,
-					pc->cols, NULL, 0, NULL);
-		if (col_eras[i])
-			col_eras_count++;
+/* Decodes column i from its syndromes and applies the corrections. The rows
+ * that were corrected are marked in row_dirty. */
+static int decode_col_syn(struct pc *pc, void *y, size_t i, int *eras,
+			  int no_eras, char *row_dirty, size_t *nlog)
+{
+	int nroots = pc->col_dec->nroots;
+	int errpos[nroots];
+	uint16_t errval[nroots];
+
+	int ret = rsdec_decode(pc->col_dec, col_syn(pc, i), pc->rows,
+			       eras, no_eras, errpos, errval);
+	for (int j = 0; j < ret; j++) {
+		apply_corr(pc, y, errpos[j], i, errval[j], nlog);
+		row_dirty[errpos[j]] = 1;
 	}
 
-	// Decode rows
-	for (size_t i = 0; i < pc->rows; i++) {
-		row_eras[i] = rs_decode(rs_r, &y[i * pc->cols], pc->cols,
-					1, NULL, 0, NULL);
-		if (row_eras[i])
-			row_eras_idx[row_eras_count++] = i;
+	return ret;
+}
+
+/* Decodes row i from its syndromes and applies the corrections. The columns
+ * that were corrected and were not dirty before are marked in col_dirty and
+ * counted in ndirty. */
+static int decode_row_syn(struct pc *pc, void *y, size_t i, int *eras,
+			  int no_eras, char *col_dirty, size_t *ndirty,
+			  size_t *nlog)
+{
+	int nroots = pc->row_dec->nroots;
+	int errpos[nroots];
+	uint16_t errval[nroots];
+
+	int ret = rsdec_decode(pc->row_dec, row_syn(pc, i), pc->cols,
+			       eras, no_eras, errpos, errval);
+	for (int j = 0; j < ret; j++) {
+		apply_corr(pc, y, i, errpos[j], errval[j], nlog);
+		if (!col_dirty[errpos[j]]) {
+			col_dirty[errpos[j]] = 1;
+			(*ndirty)++;
+		}
 	}
 
-	do {
-		memcpy(prev, y, len * sizeof(*y));
-		rounds++;
-		fail = 0;
+	return ret;
+}
 
-		// Decode columns
-		for (size_t i = 0; i < pc->cols; i++) {
-			int eras_count = col_eras[i] ? row_eras_count : 0;
-			ret = rs_decode(rs_c, &y[i], pc->rows, pc->cols,
-					row_eras_idx, eras_count, NULL);
-			fail |= ret;
-			if (eras_count && ret >= 0) {
-				col_eras[i] = 0;
-				col_eras_count--;
+/*
+ * The channel erasures that iter has not yet resolved. An erasure is
+ * resolved once a line through it is decoded with it, or is found to be a
+ * codeword, since the symbol is then as good as any other in that line.
+ * Until then the lines through it are decoded with it, as long as they have
+ * no more unresolved erasures than roots.
+ */
+static void eras_left_load(struct pc *pc)
+{
+	memset(pc->col_neras, 0, pc->cols * sizeof(*pc->col_neras));
+	memset(pc->row_neras, 0, pc->rows * sizeof(*pc->row_neras));
+	for (size_t r = 0; r < pc->rows; r++) {
+		for (size_t c = 0; c < pc->cols; c++) {
+			char e = chan_erased(pc, r * pc->cols + c);
+			pc->eras_left[r * pc->cols + c] = e;
+			pc->col_neras[c] += e;
+			pc->row_neras[r] += e;
+		}
+	}
+}
+
+/* Stores the unresolved erasures of line i, a column if col is set and a row
+ * otherwise, in pos and returns their number. Returns zero if the line is to
+ * be decoded without erasures. */
+static int line_eras(const struct pc *pc, int col, size_t i, int *pos)
+{
+	size_t len = col ? pc->rows : pc->cols;
+	size_t step = col ? pc->cols : 1;
+	const char *e = pc->eras_left + (col ? i : i * pc->cols);
+	int nroots = col ? pc->col_dec->nroots : pc->row_dec->nroots;
+	int n = col ? pc->col_neras[i] : pc->row_neras[i];
+
+	if (n == 0 || n > nroots)
+		return 0;
+
+	n = 0;
+	for (size_t j = 0; j < len; j++)
+		if (e[j * step])
+			pos[n++] = j;
+
+	return n;
+}
+
+/* Resolves the erasures of line i, as in line_eras, and marks the crossing
+ * lines dirty, counting those that were not in ndirty. Returns the number of
+ * erasures resolved. */
+static size_t resolve_eras(struct pc *pc, int col, size_t i,
+			   char *cross_dirty, size_t *ndirty)
+{
+	size_t len = col ? pc->rows : pc->cols;
+	size_t step = col ? pc->cols : 1;
+	char *e = pc->eras_left + (col ? i : i * pc->cols);
+	int *neras = col ? pc->col_neras : pc->row_neras;
+	int *cross = col ? pc->row_neras : pc->col_neras;
+	size_t n = neras[i];
+
+	if (n == 0)
+		return 0;
+
+	for (size_t j = 0; j < len; j++) {
+		if (!e[j * step])
+			continue;
+
+		e[j * step] = 0;
+		cross[j]--;
+		if (!cross_dirty[j]) {
+			cross_dirty[j] = 1;
+			(*ndirty)++;
+		}
+	}
+
+	neras[i] = 0;
+	return n;
+}
+
+/* Decodes the n lines in lb->idx from their syndromes in syn and stores the
+ * results in lb. A line decoder only reads the syndromes of its own line, so
+ * the lines are split across the team. If eras is set, the lines are the
+ * columns, or the rows, of pc and are decoded with their unresolved channel
+ * erasures. */
+static void decode_lines(struct pc *pc, const struct rsdec *rs,
+			 const uint16_t *syn, size_t len,
+			 struct line_buf *lb, size_t n, int eras)
+{
+	int nroots = rs->nroots;
+	int col = rs == pc->col_dec;
+
+	#pragma omp parallel for num_threads(pc->nthreads) \
+		if (pc->nthreads > 1 && n > 1) schedule(dynamic, 8)
+	for (size_t k = 0; k < n; k++) {
+		size_t i = lb->idx[k];
+		int pos[nroots];
+		int no_eras = eras ? line_eras(pc, col, i, pos) : 0;
+
+		lb->ret[k] = rsdec_decode(rs, syn + i * nroots, len,
+					  pos, no_eras,
+					  lb->pos + k * nroots,
+					  lb->val + k * nroots);
+	}
+}
+
+/* Decodes the dirty columns of y and then applies their corrections in order,
+ * which updates the row syndromes. The channel erasures resolved are counted
+ * in nres. Returns nonzero if some column was corrected. */
+static int col_pass(struct pc *pc, void *y, char *col_dirty,
+		    char *col_fail, char *row_dirty, size_t *nlog,
+		    size_t *nres, struct stats *s)
+{
+	struct line_buf *lb = pc->lines;
+	int nroots = pc->col_dec->nroots;
+	int eras = pc->chan_eras != NULL;
+	int corrected = 0;
+	size_t n = 0, nrows = 0, nfail = 0;
+
+	for (size_t i = 0; i < pc->cols; i++) {
+		if (!col_dirty[i])
+			continue;
+
+		col_dirty[i] = 0;
+		col_fail[i] = 0;
+		if (!rsdec_syn_zero(pc->col_dec, col_syn(pc, i)))
+			lb->idx[n++] = i;
+		else if (eras)
+			*nres += resolve_eras(pc, 1, i, row_dirty, &nrows);
+	}
+
+	lb->n = n;
+	decode_lines(pc, pc->col_dec, pc->col_syn, pc->rows, lb, n, eras);
+
+	for (size_t k = 0; k < n; k++) {
+		size_t i = lb->idx[k];
+		int ret = lb->ret[k];
+		const int *pos = lb->pos + k * nroots;
+		const uint16_t *val = lb->val + k * nroots;
+
+		for (int j = 0; j < ret; j++) {
+			apply_corr(pc, y, pos[j], i, val[j], nlog);
+			row_dirty[pos[j]] = 1;
+		}
+		if (eras && ret >= 0)
+			*nres += resolve_eras(pc, 1, i, row_dirty, &nrows);
+
+		col_fail[i] = ret < 0;
+		nfail += ret < 0;
+		corrected |= ret > 0;
+	}
+
+	PC_TRACE(col_pass, n, nfail);
+	PC_STAT(s, cdec, n);
+	return corrected;
+}
+
+/* Like col_pass, but for the rows. The columns that were corrected, or had
+ * erasures resolved, and were not dirty before are counted in ndirty. */
+static int row_pass(struct pc *pc, void *y, char *row_dirty,
+		    char *row_fail, char *col_dirty, size_t *ndirty,
+		    size_t *nlog, size_t *nres, struct stats *s)
+{
+	struct line_buf *lb = pc->lines;
+	int nroots = pc->row_dec->nroots;
+	int eras = pc->chan_eras != NULL;
+	int corrected = 0;
+	size_t n = 0, nfail = 0;
+
+	for (size_t i = 0; i < pc->rows; i++) {
+		if (!row_dirty[i])
+			continue;
+
+		row_dirty[i] = 0;
+		row_fail[i] = 0;
+		if (!rsdec_syn_zero(pc->row_dec, row_syn(pc, i)))
+			lb->idx[n++] = i;
+		else if (eras)
+			*nres += resolve_eras(pc, 0, i, col_dirty, ndirty);
+	}
+
+	lb->n = n;
+	decode_lines(pc, pc->row_dec, pc->row_syn, pc->cols, lb, n, eras);
+
+	for (size_t k = 0; k < n; k++) {
+		size_t i = lb->idx[k];
+		int ret = lb->ret[k];
+		const int *pos = lb->pos + k * nroots;
+		const uint16_t *val = lb->val + k * nroots;
+
+		for (int j = 0; j < ret; j++) {
+			apply_corr(pc, y, i, pos[j], val[j], nlog);
+			if (!col_dirty[pos[j]]) {
+				col_dirty[pos[j]] = 1;
+				(*ndirty)++;
 			}
 		}
+		if (eras && ret >= 0)
+			*nres += resolve_eras(pc, 0, i, col_dirty, ndirty);
+
+		row_fail[i] = ret < 0;
+		nfail += ret < 0;
+		corrected |= ret > 0;
+	}
 
-		if (col_eras_count) {
-			// Build col_eras
-			col_eras_count = 0;
+	PC_TRACE(row_pass, n, nfail);
+	PC_STAT(s, rdec, n);
+	return corrected;
+}
+
+/* Keeps the results of the first column pass of iter, which decodes every
+ * column of the received word, for gd to start from. The other passes get
+ * the other buffer. */
+static void keep_first_pass(struct pc *pc)
+{
+	struct line_buf *lb = pc->lines;
+
+	pc->lines = pc->first;
+	pc->first = lb;
+}
+
+/* Returns nonzero if the corrections in the log changed y, i.e., if some
+ * logged symbol differs from its value at the start of the round. */
+static int log_changed(struct pc *pc, const void *y, size_t nlog)
+{
+	uint16_t *x = pc->x_buf;
+
+	/* Walk backwards so that x ends up holding the oldest values */
+	for (size_t i = nlog; i-- > 0;)
+		x[pc->log[i].pos] = pc->log[i].old;
+
+	for (size_t i = 0; i < nlog; i++)
+		if (x[pc->log[i].pos] != sym_get(pc, y, pc->log[i].pos))
+			return 1;
+
+	return 0;
+}
+
+static double now(void)
+{
+	struct timespec tp;
+
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return tp.tv_sec + tp.tv_nsec * 1E-9;
+}
+
+/* Adds the measurement t to the running average avg */
+static inline void auto_time(double *avg, double t)
+{ *avg = *avg ? *avg + (t - *avg) / 16 : t; }
+
+/* Counts a word that a decoder got, and failed to decode if fail is set */
+static inline void auto_count(size_t *n, size_t *nfail, int fail)
+{
+	if (*n == PC_AUTO_WINDOW) {
+		*n /= 2;
+		*nfail /= 2;
+	}
+
+	(*n)++;
+	*nfail += fail != 0;
+}
+
+/* The failure rate of a decoder that failed to decode fail of n words */
+static inline double auto_rate(size_t n, size_t fail)
+{ return (fail + 1.0) / (n + 2.0); }
+
+/*
+ * Picks the order of the decoders with the least expected time for a word
+ * with nfail failed columns and ncorr corrections after the first column
+ * pass. The failure rates are those seen for earlier words in the same
+ * bucket. A word is decoded if any of the decoders decodes it, so the order
+ * only changes the time it takes. Starting with gd wastes the first pass,
+ * since iter starts over if gd fails, and gd fails also when what it decodes
+ * to is not a codeword.
+ */
+static enum auto_seq auto_choose(struct pc *pc, size_t nfail, size_t ncorr)
+{
+	struct pc_auto *au = pc->autos;
+	int nroots = pc->col_dec->nroots;
+	/* A column corrects up to nroots / 2 errors, or up to nroots symbols
+	 * when some of them are erased */
+	size_t max_corr = pc->cols * (pc->chan_eras ? nroots : nroots / 2);
+	struct auto_bucket *b = &au->b[nfail * PC_AUTO_BUCKETS / (pc->cols + 1)]
+				      [ncorr * PC_AUTO_BUCKETS / (max_corr + 1)];
+
+	au->cur = b;
+	au->mark = now();
+	auto_time(&au->t_first, au->mark - au->start);
+	if (b->words++ < PC_AUTO_WARMUP || b->words % PC_AUTO_EXPLORE == 0
+	    || !au->t_rest || !au->t_eras || !au->t_gd)
+		return AUTO_IEG;
+
+	double f_iter = auto_rate(b->iter, b->iter_fail);
+	double f_eras = auto_rate(b->eras, b->eras_fail);
+	double f_gd = auto_rate(b->gd, b->gd_fail);
+	double ieg = au->t_rest + f_iter * (au->t_eras + f_eras * au->t_gd);
+	double gie = au->t_gd + f_gd * (au->t_first + au->t_rest
+					+ f_iter * au->t_eras);
+
+	return gie < ieg ? AUTO_GIE : AUTO_IEG;
+}
+
+/*
+ * Iterative decoding with the syndromes of all rows and columns kept for the
+ * whole decoding. The component decoders work on the syndromes alone, and
+ * each correction updates the syndromes of the line crossing it, which is
+ * then marked dirty. Lines with all-zero syndromes are valid codewords and are
+ * never decoded. A line that has not changed since it was last decoded would
+ * decode to the same result, so the decoder has converged when a row pass
+ * leaves no column dirty.
+ *
+ * A row may undo a correction made by a column in the same round, in which
+ * case the dirty set never empties. The corrections made in each round are
+ * therefore logged and a round that changed nothing ends the decoding, as a
+ * failure if some line still had to be corrected.
+ *
+ * Channel erasures are decoded with until a line through them is decoded.
+ * Resolving them marks the crossing lines dirty, and counts as a change,
+ * since those lines may now decode with fewer erasures.
+ *
+ * If choose is set, the auto decoder picks its cascade after the first column
+ * pass, and 1 is returned right away if it starts with gd.
+ */
+static int iter_decode(struct pc *pc, uint16_t *data, struct stats *s,
+		       int choose)
+{
+	size_t len = pc_len(pc);
+	void *y = pc->w_buf;
+	char *col_dirty = pc->col_dirty, *row_dirty = pc->row_dirty;
+	char *col_fail = pc->col_fail, *row_fail = pc->row_fail;
+	size_t ndirty, nlog, nres;
+	int corrected, changed;
+	int first = 1, round = 0;
+	int fail = 0;
+
+	sym_load(pc, y, data, len);
+	compute_syndromes(pc, y);
+	memset(col_dirty, 1, pc->cols + pc->rows);
+	memset(col_fail, 0, pc->cols + pc->rows);
+	if (pc->chan_eras)
+		eras_left_load(pc);
+
+	do {
+		nlog = 0;
+		ndirty = 0;
+		nres = 0;
+
+		corrected = col_pass(pc, y, col_dirty, col_fail, row_dirty,
+				     &nlog, &nres, s);
+		if (first) {
+			keep_first_pass(pc);
+			first = 0;
+		}
+		if (choose) {
+			size_t nfail = 0;
 			for (size_t i = 0; i < pc->cols; i++)
-				if (col_eras[i])
-					col_eras_idx[col_eras_count++] = i;
+				nfail += col_fail[i];
+
+			choose = 0;
+			pc->autos->seq = auto_choose(pc, nfail, nlog);
+			if (pc->autos->seq == AUTO_GIE)
+				return 1;
 		}
+		corrected |= row_pass(pc, y, row_dirty, row_fail, col_dirty,
+				      &ndirty, &nlog, &nres, s);
+
+		changed = log_changed(pc, y, nlog) || nres;
+		round++;
+		PC_STAT(s, rounds, 1);
+		PC_TRACE(iter_round, round, ndirty, nlog);
+	} while (ndirty && changed);
+
+	/* As with the line decoders, a line that failed makes the result
+	 * negative, and corrections in the last round, which only undid
+	 * earlier ones, make it positive. The word is kept in both cases. */
+	int undone = ndirty && corrected;
+	for (size_t i = 0; i < pc->cols; i++)
+		fail |= col_fail[i];
+	for (size_t i = 0; i < pc->rows; i++)
+		fail |= row_fail[i];
+
+	if (!fail && !undone)
+		sym_store(pc, data, y, len);
+
+	return fail ? -1 : undone;
+}
+
+int pc_decode_iter(struct pc *pc, uint16_t *data, struct stats *s)
+{ return iter_decode(pc, data, s, 0); }
+
+static void build_eras_idx(const int *eras, size_t n, int *idx, int *count)
+{
+	*count = 0;
+	for (size_t i = 0; i < n; i++)
+		if (eras[i])
+			idx[(*count)++] = i;
+}
+
+/*
+ * Iterative errors-and-erasures decoding on the syndromes and line flags left
+ * by pc_decode_iter, with the same dirty-line tracking. A line flagged as an
+ * erasure line must also be re-decoded when the set of erasures it is decoded
+ * with has changed, which is tracked with a version number for each erasure
+ * set.
+ */
+static int eras_decode(struct pc *pc, uint16_t *data, struct stats *s)
+{
+	size_t len = pc_len(pc);
+	void *y = pc->w_buf;
+	int col_eras[pc->cols], col_eras_idx[pc->cols];
+	int row_eras[pc->rows], row_eras_idx[pc->rows];
+	int col_eras_count, row_eras_count;
+	char *col_dirty = pc->col_dirty, *row_dirty = pc->row_dirty;
+	char *col_fail = pc->col_fail, *row_fail = pc->row_fail;
+	unsigned col_seen[pc->cols], row_seen[pc->rows];
+	unsigned col_eras_ver = 1, row_eras_ver = 1;
+	size_t ndirty = 0, nlog = 0;
+	int corrected, changed, ret;
+	int fail = 0;
+
+	/* A column that iter has not changed since it last decoded it would
+	 * decode the same way again. Its syndromes are zero if that decoding
+	 * succeeded, so only the dirty columns need to be decoded. */
+	for (size_t i = 0; i < pc->cols; i++) {
+		col_eras[i] = 0;
+		if (rsdec_syn_zero(pc->col_dec, col_syn(pc, i)))
+			continue;
+
+		if (!col_dirty[i]) {
+			col_eras[i] = -1;
+			continue;
+		}
+
+		col_eras[i] = decode_col_syn(pc, y, i, NULL, 0,
+					     row_dirty, &nlog);
+		PC_STAT(s, cdec, 1);
+	}
+
+	/* The same for the rows, which iter left clean */
+	memset(col_dirty, 0, pc->cols);
+	for (size_t i = 0; i < pc->rows; i++) {
+		row_eras[i] = 0;
+		if (rsdec_syn_zero(pc->row_dec, row_syn(pc, i)))
+			continue;
+
+		if (!row_dirty[i]) {
+			row_eras[i] = -1;
+			continue;
+		}
+
+		row_eras[i] = decode_row_syn(pc, y, i, NULL, 0, col_dirty,
+					     &ndirty, &nlog);
+		PC_STAT(s, rdec, 1);
+	}
+
+	build_eras_idx(col_eras, pc->cols, col_eras_idx, &col_eras_count);
+	build_eras_idx(row_eras, pc->rows, row_eras_idx, &row_eras_count);
+
+	/* Only the lines that will be decoded with erasures, and the lines
+	 * crossing corrections made above, need another decoding. */
+	memset(col_dirty, 0, pc->cols + pc->rows);
+	memset(col_seen, 0, sizeof(col_seen));
+	memset(row_seen, 0, sizeof(row_seen));
+	for (size_t i = 0; i < nlog; i++)
+		col_dirty[pc->log[i].pos % pc->cols] = 1;
+	for (size_t i = 0; i < pc->cols; i++)
+		col_fail[i] = col_eras[i] < 0;
+	for (size_t i = 0; i < pc->rows; i++)
+		row_fail[i] = row_eras[i] < 0;
+
+	do {
+		corrected = 0;
+		nlog = 0;
+
+		// Decode columns
+		for (size_t i = 0; i < pc->cols; i++)
+			if (col_eras[i] && col_seen[i] != row_eras_ver)
+				col_dirty[i] = 1;
+
+		for (size_t i = 0; i < pc->cols; i++) {
+			if (!col_dirty[i])
+				continue;
+
+			int eras_count = col_eras[i] ? row_eras_count : 0;
+			col_dirty[i] = 0;
+			col_seen[i] = row_eras_ver;
+			ret = decode_col_syn(pc, y, i, row_eras_idx, eras_count,
+					     row_dirty, &nlog);
+			col_fail[i] = ret < 0;
+			if (eras_count && ret >= 0)
+				col_eras[i] = 0;
+			corrected |= ret > 0;
+			PC_STAT(s, cdec, 1);
+		}
+
+		int old_count = col_eras_count;
+		build_eras_idx(col_eras, pc->cols, col_eras_idx, &col_eras_count);
+		if (col_eras_count != old_count)
+			col_eras_ver++;
 
 		// Decode rows
+		for (size_t i = 0; i < pc->rows; i++)
+			if (row_eras[i] && row_seen[i] != col_eras_ver)
+				row_dirty[i] = 1;
+
 		for (size_t i = 0; i < pc->rows; i++) {
+			if (!row_dirty[i])
+				continue;
+
 			int eras_count = row_eras[i] ? col_eras_count : 0;
-			ret = rs_decode(rs_r, &y[i * pc->cols], pc->cols, 1,
-					col_eras_idx, eras_count, NULL);
-			fail |= ret;
-			if (eras_count && ret >= 0) {
+			row_dirty[i] = 0;
+			row_seen[i] = col_eras_ver;
+			ret = decode_row_syn(pc, y, i, col_eras_idx, eras_count,
+					     col_dirty, &ndirty, &nlog);
+			row_fail[i] = ret < 0;
+			if (eras_count && ret >= 0)
 				row_eras[i] = 0;
-				row_eras_count--;
-			}
+			corrected |= ret > 0;
+			PC_STAT(s, rdec, 1);
 		}
 
-		if (row_eras_count) {
-			// Build col_eras
-			row_eras_count = 0;
-			for (size_t i = 0; i < pc->rows; i++)
-				if (row_eras[i])
-					row_eras_idx[row_eras_count++] = i;
-		}
-	} while (memcmp(y, prev, len * sizeof(*y)) != 0);
+		old_count = row_eras_count;
+		build_eras_idx(row_eras, pc->rows, row_eras_idx, &row_eras_count);
+		if (row_eras_count != old_count)
+			row_eras_ver++;
 
-	if (!fail)
-		memcpy(data, y, len * sizeof(*y));
+		changed = log_changed(pc, y, nlog);
+		PC_STAT(s, rounds, 1);
+	} while (changed);
 
-	s->cdec += pc->cols * rounds;
-	s->rdec += pc->rows * rounds;
-	return fail;
+	/* The result is as for iter */
+	for (size_t i = 0; i < pc->cols; i++)
+		fail |= col_fail[i];
+	for (size_t i = 0; i < pc->rows; i++)
+		fail |= row_fail[i];
+
+	if (!fail && !corrected)
+		sym_store(pc, data, y, len);
+
+	return fail ? -1 : corrected;
+}
+
+int pc_decode_eras(struct pc *pc, uint16_t *data, struct stats *s)
+{
+	int ret = pc_decode_iter(pc, data, s);
+	if (!ret)
+		return ret;
+
+	PC_STAT(s, alg2, 1);
+	return eras_decode(pc, data, s);
 }
 
 int pc_decode_iter_gd(struct pc *pc, uint16_t *data, struct stats *s)
 {
 	int ret = pc_decode_iter(pc, data, s);
 	if (ret) {
-		s->alg2++;
-		ret = pc_decode_gd(pc, data, s);
+		PC_STAT(s, alg2, 1);
+		PC_TRACE(gd_fallback, "itergd");
+		ret = gd_decode(pc, data, s, 1);
 	}
 
 	return ret;
@@ -504,13 +1663,440 @@ int pc_decode_eras_gd(struct pc *pc, uint16_t *data, struct stats *s)
 {
 	int ret = pc_decode_eras(pc, data, s);
 	if (ret) {
-		s->alg3++;
-		ret = pc_decode_gd(pc, data, s);
+		PC_STAT(s, alg3, 1);
+		PC_TRACE(gd_fallback, "erasgd");
+		ret = gd_decode(pc, data, s, 1);
 	}
 
 	return ret;
 }
 
+/* Runs gd for pc_decode_auto. gd does not check that the rows it picks make
+ * up a codeword, so its result is checked here. Returns 1 if gd decoded the
+ * word to something that is not a codeword, which counts as a failure. */
+static int auto_gd(struct pc *pc, uint16_t *data, struct stats *s)
+{
+	struct pc_auto *au = pc->autos;
+	double t = now();
+
+	int ret = gd_decode(pc, data, s, 1);
+	if (!ret && !pc_check(pc, data))
+		ret = 1;
+
+	auto_time(&au->t_gd, now() - t);
+	auto_count(&au->cur->gd, &au->cur->gd_fail, ret);
+	return ret;
+}
+
+/* Runs eras after iter for pc_decode_auto */
+static int auto_eras(struct pc *pc, uint16_t *data, struct stats *s)
+{
+	struct pc_auto *au = pc->autos;
+	double t = now();
+
+	int ret = eras_decode(pc, data, s);
+	auto_time(&au->t_eras, now() - t);
+	auto_count(&au->cur->eras, &au->cur->eras_fail, ret);
+	return ret;
+}
+
+int pc_decode_auto(struct pc *pc, uint16_t *data, struct stats *s)
+{
+	struct pc_auto *au = pc->autos;
+
+	au->start = now();
+	int ret = iter_decode(pc, data, s, 1);
+	if (au->seq == AUTO_GIE) {
+		/* Only the words that gd fails need the first pass again. A
+		 * word that gd miscorrected is restored for iter. */
+		memcpy(au->word, data, pc_len(pc) * sizeof(*data));
+		ret = auto_gd(pc, data, s);
+		if (!ret)
+			return 0;
+		if (ret > 0)
+			memcpy(data, au->word, pc_len(pc) * sizeof(*data));
+
+		/* A whole iter, with the first pass that t_first already
+		 * has, so it is not timed into t_rest */
+		PC_STAT(s, alg2, 1);
+		ret = pc_decode_iter(pc, data, s);
+	} else {
+		auto_time(&au->t_rest, now() - au->mark);
+	}
+
+	auto_count(&au->cur->iter, &au->cur->iter_fail, ret);
+	if (!ret)
+		return 0;
+
+	if (au->seq == AUTO_IEG) {
+		PC_STAT(s, alg2, 1);
+		ret = auto_eras(pc, data, s);
+		if (!ret)
+			return 0;
+
+		/* The last decoder, so its result is kept as erasgd would */
+		PC_STAT(s, alg3, 1);
+		PC_TRACE(gd_fallback, "auto");
+		ret = auto_gd(pc, data, s);
+		return ret > 0 ? 0 : ret;
+	}
+
+	PC_STAT(s, alg3, 1);
+	return auto_eras(pc, data, s);
+}
+
+struct pc_batch {
+	struct pc *pc;
+	size_t width;
+	void *y;		/* working copy of the words */
+	uint16_t *x;		/* scratch, as large as y */
+	uint16_t *row_syn;	/* r_nroots syndromes per row and word */
+	uint16_t *col_syn;	/* c_nroots syndromes per column and word */
+	struct corr *log;	/* corrections made in one round */
+	struct line_buf *lines;
+
+	/* Line i of word w is at i * width + w */
+	char *col_dirty, *row_dirty;
+	char *col_fail, *row_fail;
+
+	/* Per word */
+	char *active, *corrected, *changed;
+	size_t *ndirty;
+};
+
+void pc_batch_free(struct pc_batch *b)
+{
+	if (!b)
+		return;
+
+	free(b->ndirty);
+	free(b->active);
+	free(b->col_dirty);
+	line_buf_free(b->lines);
+	free(b->log);
+	free(b->row_syn);
+	free(b->x);
+	free(b->y);
+	free(b);
+}
+
+struct pc_batch *pc_batch_init(struct pc *pc, size_t width)
+{
+	size_t len = pc_len(pc);
+	size_t nsyn = pc->rows * pc->row_dec->nroots +
+		      pc->cols * pc->col_dec->nroots;
+	size_t nlines = pc->rows + pc->cols;
+
+	if (width == 0)
+		return NULL;
+
+	struct pc_batch *b = calloc(1, sizeof(*b));
+	if (!b)
+		return NULL;
+
+	b->pc = pc;
+	b->width = width;
+
+	b->y = malloc(width * len * pc->symbytes);
+	if (!b->y)
+		goto err;
+
+	b->x = malloc(width * len * sizeof(*b->x));
+	if (!b->x)
+		goto err;
+
+	b->row_syn = malloc(width * nsyn * sizeof(*b->row_syn));
+	if (!b->row_syn)
+		goto err;
+
+	b->col_syn = b->row_syn + width * pc->rows * pc->row_dec->nroots;
+
+	b->log = malloc(width * nsyn * sizeof(*b->log));
+	if (!b->log)
+		goto err;
+
+	b->lines = line_buf_alloc(pc, width);
+	if (!b->lines)
+		goto err;
+
+	b->col_dirty = malloc(2 * width * nlines);
+	if (!b->col_dirty)
+		goto err;
+
+	b->row_dirty = b->col_dirty + width * pc->cols;
+	b->col_fail = b->row_dirty + width * pc->rows;
+	b->row_fail = b->col_fail + width * pc->cols;
+
+	b->active = malloc(3 * width);
+	if (!b->active)
+		goto err;
+
+	b->corrected = b->active + width;
+	b->changed = b->corrected + width;
+
+	b->ndirty = malloc(width * sizeof(*b->ndirty));
+	if (!b->ndirty)
+		goto err;
+
+	return b;
+
+err:
+	pc_batch_free(b);
+	return NULL;
+}
+
+static inline uint16_t *batch_row_syn(struct pc_batch *b, size_t r, size_t w)
+{ return &b->row_syn[(r * b->width + w) * b->pc->row_dec->nroots]; }
+
+static inline uint16_t *batch_col_syn(struct pc_batch *b, size_t c, size_t w)
+{ return &b->col_syn[(c * b->width + w) * b->pc->col_dec->nroots]; }
+
+/*
+ * Row r of the batch holds the rows r of all words as width interleaved words
+ * of length cols, and the whole batch holds the columns of all words as
+ * cols * width interleaved words of length rows. The syndromes of all words
+ * are thus computed in the same passes over memory as those of one word,
+ * with the words in the innermost loop.
+ */
+static void batch_syndromes(struct pc_batch *b)
+{
+	struct pc *pc = b->pc;
+	size_t width = b->width;
+
+	#pragma omp parallel for num_threads(pc->nthreads) if (pc->nthreads > 1)
+	for (size_t r = 0; r < pc->rows; r++)
+		sym_syndrome_interleaved(pc, pc->row_dec, b->y,
+					 r * pc->cols * width, pc->cols,
+					 width, batch_row_syn(b, r, 0));
+
+	sym_syndrome_interleaved(pc, pc->col_dec, b->y, 0, pc->rows,
+				 pc->cols * width, b->col_syn);
+}
+
+/* Like apply_corr, for word w of the batch */
+static void batch_apply_corr(struct pc_batch *b, size_t r, size_t c, size_t w,
+			     uint16_t val, size_t *nlog)
+{
+	struct pc *pc = b->pc;
+	size_t pos = (r * pc->cols + c) * b->width + w;
+
+	b->log[*nlog].pos = pos;
+	b->log[(*nlog)++].old = sym_get(pc, b->y, pos);
+	sym_xor(pc, b->y, pos, val);
+
+	rsdec_syn_update(pc->row_dec, batch_row_syn(b, r, w), pc->cols, c, val);
+	rsdec_syn_update(pc->col_dec, batch_col_syn(b, c, w), pc->rows, r, val);
+}
+
+/* Like col_pass, for the dirty columns of all active words */
+static void batch_col_pass(struct pc_batch *b, size_t *nlog, struct stats *s)
+{
+	struct pc *pc = b->pc;
+	struct line_buf *lb = b->lines;
+	size_t width = b->width;
+	int nroots = pc->col_dec->nroots;
+	size_t n = 0;
+
+	for (size_t i = 0; i < pc->cols * width; i++) {
+		if (!b->active[i % width] || !b->col_dirty[i])
+			continue;
+
+		b->col_dirty[i] = 0;
+		b->col_fail[i] = 0;
+		if (!rsdec_syn_zero(pc->col_dec, b->col_syn + i * nroots))
+			lb->idx[n++] = i;
+	}
+
+	decode_lines(pc, pc->col_dec, b->col_syn, pc->rows, lb, n, 0);
+
+	for (size_t k = 0; k < n; k++) {
+		size_t i = lb->idx[k];
+		size_t c = i / width, w = i % width;
+		int ret = lb->ret[k];
+		const int *pos = lb->pos + k * nroots;
+		const uint16_t *val = lb->val + k * nroots;
+
+		for (int j = 0; j < ret; j++) {
+			batch_apply_corr(b, pos[j], c, w, val[j], nlog);
+			b->row_dirty[pos[j] * width + w] = 1;
+		}
+
+		b->col_fail[i] = ret < 0;
+		b->corrected[w] |= ret > 0;
+	}
+
+	PC_STAT(s, cdec, n);
+}
+
+/* Like row_pass, for the dirty rows of all active words */
+static void batch_row_pass(struct pc_batch *b, size_t *nlog, struct stats *s)
+{
+	struct pc *pc = b->pc;
+	struct line_buf *lb = b->lines;
+	size_t width = b->width;
+	int nroots = pc->row_dec->nroots;
+	size_t n = 0;
+
+	for (size_t i = 0; i < pc->rows * width; i++) {
+		if (!b->active[i % width] || !b->row_dirty[i])
+			continue;
+
+		b->row_dirty[i] = 0;
+		b->row_fail[i] = 0;
+		if (!rsdec_syn_zero(pc->row_dec, b->row_syn + i * nroots))
+			lb->idx[n++] = i;
+	}
+
+	decode_lines(pc, pc->row_dec, b->row_syn, pc->cols, lb, n, 0);
+
+	for (size_t k = 0; k < n; k++) {
+		size_t i = lb->idx[k];
+		size_t r = i / width, w = i % width;
+		int ret = lb->ret[k];
+		const int *pos = lb->pos + k * nroots;
+		const uint16_t *val = lb->val + k * nroots;
+
+		for (int j = 0; j < ret; j++) {
+			batch_apply_corr(b, r, pos[j], w, val[j], nlog);
+			char *dirty = &b->col_dirty[pos[j] * width + w];
+			if (!*dirty) {
+				*dirty = 1;
+				b->ndirty[w]++;
+			}
+		}
+
+		b->row_fail[i] = ret < 0;
+		b->corrected[w] |= ret > 0;
+	}
+
+	PC_STAT(s, rdec, n);
+}
+
+/* Like log_changed, but marks the words that changed in b->changed */
+static void batch_log_changed(struct pc_batch *b, size_t nlog)
+{
+	memset(b->changed, 0, b->width);
+
+	for (size_t i = nlog; i-- > 0;)
+		b->x[b->log[i].pos] = b->log[i].old;
+
+	for (size_t i = 0; i < nlog; i++) {
+		size_t pos = b->log[i].pos;
+		if (b->x[pos] != sym_get(b->pc, b->y, pos))
+			b->changed[pos % b->width] = 1;
+	}
+}
+
+/* Ends the decoding of word w and copies it to data if it was decoded */
+static int batch_finish(struct pc_batch *b, uint16_t *data, size_t w)
+{
+	struct pc *pc = b->pc;
+	size_t width = b->width;
+	int undone = b->ndirty[w] && b->corrected[w];
+	int fail = 0;
+
+	for (size_t i = 0; i < pc->cols; i++)
+		fail |= b->col_fail[i * width + w];
+	for (size_t i = 0; i < pc->rows; i++)
+		fail |= b->row_fail[i * width + w];
+
+	if (!fail && !undone)
+		for (size_t j = w; j < pc_len(pc) * width; j += width)
+			data[j] = sym_get(pc, b->y, j);
+
+	return fail ? -1 : undone;
+}
+
+/*
+ * Runs pc_decode_iter on all words of the batch in lockstep. Each round makes
+ * one column pass and one row pass over the dirty lines of all the words that
+ * are still being decoded, and the words that have converged are masked out
+ * of the following rounds. The words do not interact, so every word gets the
+ * same result as with pc_decode_iter.
+ */
+size_t pc_decode_iter_batch(struct pc_batch *b, uint16_t *data, int *ret,
+			    struct stats *s)
+{
+	struct pc *pc = b->pc;
+	size_t width = b->width;
+	size_t nactive = width, nfail = 0;
+
+	sym_load(pc, b->y, data, pc_len(pc) * width);
+	batch_syndromes(b);
+	memset(b->col_dirty, 1, width * (pc->rows + pc->cols));
+	memset(b->col_fail, 0, width * (pc->rows + pc->cols));
+	memset(b->active, 1, width);
+
+	while (nactive) {
+		size_t nlog = 0;
+
+		memset(b->corrected, 0, width);
+		memset(b->ndirty, 0, width * sizeof(*b->ndirty));
+
+		batch_col_pass(b, &nlog, s);
+		batch_row_pass(b, &nlog, s);
+		batch_log_changed(b, nlog);
+
+		for (size_t w = 0; w < width; w++) {
+			if (!b->active[w] || (b->ndirty[w] && b->changed[w]))
+				continue;
+
+			b->active[w] = 0;
+			nactive--;
+			ret[w] = batch_finish(b, data, w);
+			nfail += ret[w] != 0;
+		}
+	}
+
+	return nfail;
+}
+
+/* Runs pc_decode_iter_batch, and then the erasure decoding of pc_decode_eras
+ * one word at a time on the words that iter could not decode. */
+size_t pc_decode_eras_batch(struct pc_batch *b, uint16_t *data, int *ret,
+			    struct stats *s)
+{
+	struct pc *pc = b->pc;
+	size_t width = b->width;
+	size_t len = pc_len(pc);
+	size_t r_nroots = pc->row_dec->nroots;
+	size_t c_nroots = pc->col_dec->nroots;
+	uint16_t *word = b->x;
+
+	size_t nfail = pc_decode_iter_batch(b, data, ret, s);
+
+	for (size_t w = 0; w < width && nfail; w++) {
+		if (!ret[w])
+			continue;
+
+		/* Continue from where iter left the word */
+		for (size_t j = 0; j < len; j++)
+			sym_set(pc, pc->w_buf, j,
+				sym_get(pc, b->y, j * width + w));
+		for (size_t i = 0; i < pc->rows; i++)
+			memcpy(row_syn(pc, i), batch_row_syn(b, i, w),
+			       r_nroots * sizeof(*pc->row_syn));
+		for (size_t i = 0; i < pc->cols; i++)
+			memcpy(col_syn(pc, i), batch_col_syn(b, i, w),
+			       c_nroots * sizeof(*pc->col_syn));
+		for (size_t i = 0; i < pc->cols; i++)
+			pc->col_dirty[i] = b->col_dirty[i * width + w];
+		for (size_t i = 0; i < pc->rows; i++)
+			pc->row_dirty[i] = b->row_dirty[i * width + w];
+
+		PC_STAT(s, alg2, 1);
+		ret[w] = eras_decode(pc, word, s);
+		if (ret[w])
+			continue;
+
+		for (size_t j = 0; j < len; j++)
+			data[j * width + w] = word[j];
+		nfail--;
+	}
+
+	return nfail;
+}
+
 void pc_print(FILE *file, const struct pc *pc, const char *prefix)
 {
 	size_t nn = pc->row_code->nn;
@@ -26,12 +26,38 @@
 #include <stdint.h>
 #include <librs.h>
 #include <stdio.h>
+#include "rsdec.h"
 
 struct estrat;
+struct corr;
+struct line_buf;
+struct pc_batch;
+struct pc_auto;
+
+/* Storage of the working copy used by the column passes. */
+enum pc_layout {
+	PC_LAYOUT_AUTO,
+	PC_LAYOUT_STRIDED,
+	PC_LAYOUT_TRANSPOSED
+};
+
+/* With PC_LAYOUT_AUTO the transposed layout is used once a strided column,
+ * which touches one cache line per row, needs more lines than fit in the L1
+ * data cache. These are assumed when sysconf() does not know the cache. Run
+ * 'pcbench' to find the crossover on a particular machine. */
+#define PC_L1_SIZE 32768
+#define PC_LINE_SIZE 64
+
+/* Codewords with at least this many symbols are decoded faster by a team of
+ * threads working on one codeword than by one thread per codeword, since the
+ * working set of each thread no longer fits in its caches. */
+#define PC_PAR_MIN_LEN (1 << 18)
 
 struct pc {
 	struct rs_code *row_code;
 	struct rs_code *col_code;
+	struct rsdec *row_dec;
+	struct rsdec *col_dec;
 	size_t rows;
 	size_t cols;
 	size_t nstrat;
@@ -39,9 +65,33 @@ struct pc {
 
 	struct estrat *es;
 	int *es_buffer;
+	uint16_t *es_lambda;
 
 	uint16_t *x_buf;
-	uint16_t *y_buf;
+
+	/* The working copies below store a symbol in symbytes bytes, which is
+	 * one byte for symsize <= 8 */
+	size_t symbytes;
+	void *t_buf;		/* transposed copy; NULL if strided */
+	void *w_buf;		/* word decoded by iter and eras */
+
+	uint16_t *row_syn;	/* r_nroots syndromes per row */
+	uint16_t *col_syn;	/* c_nroots syndromes per column */
+	struct corr *log;	/* corrections made in one round */
+
+	int nthreads;		/* threads decoding a single codeword */
+	struct line_buf *lines;	/* line decoder results of a pass */
+	struct line_buf *first;	/* the first column pass of iter, for gd */
+
+	/* The state of the lines after iter, which eras starts from */
+	char *col_dirty, *row_dirty;	/* changed since last decoded */
+	char *col_fail, *row_fail;	/* last decoding failed */
+	struct pc_auto *autos;	/* cost model of pc_decode_auto */
+
+	/* Erasures flagged by the channel, see pc_set_erasures */
+	const uint8_t *chan_eras;
+	char *eras_left;		/* not yet resolved by iter */
+	int *col_neras, *row_neras;	/* unresolved ones per line */
 };
 
 struct stats {
@@ -56,8 +106,21 @@ struct stats {
 	size_t cfail;
 	size_t alg2;
 	size_t alg3;
+	size_t rounds;
 };
 
+/* The decoders skip the bookkeeping if their stats are NULL. Building with
+ * PC_NO_STATS defined compiles it out altogether. */
+#ifdef PC_NO_STATS
+#define PC_STAT(s, field, n) ((void) (s))
+#else
+#define PC_STAT(s, field, n)			\
+	do {					\
+		if (s)				\
+			(s)->field += (n);	\
+	} while (0)
+#endif
+
 static inline void stats_add(struct stats *l, const struct stats *r)
 {
 	l->nwords += r->nwords;
@@ -71,6 +134,7 @@ static inline void stats_add(struct stats *l, const struct stats *r)
 	l->cfail += r->cfail;
 	l->alg2 += r->alg2;
 	l->alg3 += r->alg3;
+	l->rounds += r->rounds;
 }
 
 size_t get_gfpoly(size_t symsize);
@@ -89,8 +153,41 @@ struct pc *pc_init(size_t symsize, size_t gfpoly,
 
 void pc_free(struct pc *pc);
 
+/* Creates a code with the same parameters and layout as pc, with buffers of
+ * its own, for decoding in another thread. */
+struct pc *pc_clone(const struct pc *pc);
+
+/* Selects how the column passes access the codeword. Returns zero on success
+ * and -1 if the transposed working copy could not be allocated. */
+int pc_set_layout(struct pc *pc, enum pc_layout layout);
+
+/* Sets the number of threads that share the decoding of a single codeword.
+ * The column and row passes are split across the team, except for the row
+ * pass of GMD decoding, which is sequential. Returns 0 on success and -1 on
+ * failure. */
+int pc_set_threads(struct pc *pc, int nthreads);
+
+/*
+ * Sets the bitmap of the symbols that the channel flagged as erased, for the
+ * words decoded with pc from now on. Symbol i is erased if bit i % 8 of
+ * eras[i / 8] is set, and the bitmap is read anew by each call of a decoder,
+ * so it can be refilled for each word. NULL means no erasures. The bitmap is
+ * not copied by pc_clone.
+ *
+ * The column passes of gmd, gd and iter decode each column with the erasures
+ * in it, if there are no more than its roots, and the erasures that remain
+ * after a column pass go to the rows in iter. The weights of the columns in
+ * gmd and gd count an erasure as half an error. eras, after iter, works from
+ * what iter left, and the batch decoders and pc_ooc do not take erasures.
+ * Returns 0 on success and -1 on failure.
+ */
+int pc_set_erasures(struct pc *pc, const uint8_t *eras);
+
 void pc_encode(struct pc *pc, uint16_t *data);
 
+/* Returns nonzero if data is a codeword. Uses the buffers of pc. */
+int pc_check(struct pc *pc, const uint16_t *data);
+
 int pc_decode_gmd(struct pc *pc, uint16_t *data, struct stats *s);
 int pc_decode_gd(struct pc *pc, uint16_t *data, struct stats *s);
 int pc_decode_iter(struct pc *pc, uint16_t *data, struct stats *s);
@@ -98,6 +195,35 @@ int pc_decode_iter_gd(struct pc *pc, uint16_t *data, struct stats *s);
 int pc_decode_eras(struct pc *pc, uint16_t *data, struct stats *s);
 int pc_decode_eras_gd(struct pc *pc, uint16_t *data, struct stats *s);
 
+/*
+ * Decodes with iter, eras and gd in the order with the least expected time.
+ * The order is chosen after the first column pass of iter, from the number of
+ * columns that failed and of corrections made, the failure rates seen for
+ * earlier words that were alike in these and the running time of each
+ * decoder measured so far. A word is decoded if one of the decoders decodes
+ * it, as with erasgd, but a word that two decoders decode to different
+ * codewords may end up with either, depending on timings. When gd goes first,
+ * a result of it that is not a codeword is passed on to iter and eras like a
+ * failure. In the stats, alg2 and alg3 count the words passed to a second and
+ * a third decoder.
+ */
+int pc_decode_auto(struct pc *pc, uint16_t *data, struct stats *s);
+
+/*
+ * Batch decoding of width words at a time. The words are interleaved: symbol
+ * j of word w is at data[j * width + w]. The result of word w, as for the
+ * single word decoders, is stored in ret[w], and the number of words that
+ * could not be decoded is returned. A batch belongs to the code it was
+ * created for and uses its buffers.
+ */
+struct pc_batch *pc_batch_init(struct pc *pc, size_t width);
+void pc_batch_free(struct pc_batch *b);
+
+size_t pc_decode_iter_batch(struct pc_batch *b, uint16_t *data, int *ret,
+			    struct stats *s);
+size_t pc_decode_eras_batch(struct pc_batch *b, uint16_t *data, int *ret,
+			    struct stats *s);
+
 void pc_print(FILE *file, const struct pc *pc, const char *prefix);
 
 static inline size_t pc_len(const struct pc *pc)
@@ -0,0 +1,1018 @@
+/*
+ * rsdec.c
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#include "rsdec.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* The list of (symsize, nroots) pairs that get specialized kernels. Define
+ * RSDEC_KERNELS_DEF at build time to use another list. */
+#ifndef RSDEC_KERNELS_DEF
+#define RSDEC_KERNELS_DEF "rsdec_kernels.def"
+#endif
+
+static inline int modnn_fixed(int x, int mm)
+{
+	int nn = (1 << mm) - 1;
+
+	while (x >= nn) {
+		x -= nn;
+		x = (x >> mm) + (x & nn);
+	}
+	return x;
+}
+
+/*
+ * Generates the syndrome kernels name and name##_interleaved for words stored
+ * with one symbol per type, for codes with NROOTS roots over GF(2^MM). The
+ * generic kernels get the parameters from rs. The specialized kernels get
+ * them as constants, so that the compiler can unroll the loops over the roots
+ * and keep the syndromes in registers.
+ */
+#define RSDEC_SYNDROME_FUNCS(name, type, NROOTS, MM)			\
+static void name(const struct rsdec *rs, const type *data,		\
+		 size_t len, size_t stride, uint16_t *syn)		\
+{									\
+	const uint16_t *alpha_to = rs->alpha_to;			\
+	const uint16_t *index_of = rs->index_of;			\
+	const int nroots = NROOTS;					\
+	uint16_t root[NROOTS], acc[NROOTS];				\
+									\
+	for (int i = 0; i < nroots; i++) {				\
+		root[i] = rs->root[i];					\
+		acc[i] = data[0];					\
+	}								\
+									\
+	for (size_t j = 1; j < len; j++) {				\
+		uint16_t d = data[j * stride];				\
+		for (int i = 0; i < nroots; i++) {			\
+			if (acc[i] == 0)				\
+				acc[i] = d;				\
+			else						\
+				acc[i] = d ^ alpha_to[modnn_fixed(	\
+					index_of[acc[i]] + root[i], MM)]; \
+		}							\
+	}								\
+									\
+	memcpy(syn, acc, nroots * sizeof(*syn));			\
+}									\
+									\
+static void name##_interleaved(const struct rsdec *rs,		\
+			       const type *data, size_t len,		\
+			       size_t n, uint16_t *syn)			\
+{									\
+	const uint16_t *alpha_to = rs->alpha_to;			\
+	const uint16_t *index_of = rs->index_of;			\
+	const int nroots = NROOTS;					\
+	uint16_t root[NROOTS];						\
+									\
+	for (int i = 0; i < nroots; i++)				\
+		root[i] = rs->root[i];					\
+									\
+	for (size_t c = 0; c < n; c++)					\
+		for (int i = 0; i < nroots; i++)			\
+			syn[c * nroots + i] = data[c];			\
+									\
+	for (size_t j = 1; j < len; j++) {				\
+		const type *row = data + j * n;				\
+		for (size_t c = 0; c < n; c++) {			\
+			uint16_t *sc = syn + c * nroots;		\
+			for (int i = 0; i < nroots; i++) {		\
+				if (sc[i] == 0)				\
+					sc[i] = row[c];			\
+				else					\
+					sc[i] = row[c] ^ alpha_to[modnn_fixed( \
+						index_of[sc[i]] + root[i], MM)]; \
+			}						\
+		}							\
+	}								\
+}
+
+RSDEC_SYNDROME_FUNCS(syndrome_generic16, uint16_t, rs->nroots, rs->mm)
+RSDEC_SYNDROME_FUNCS(syndrome_generic8, uint8_t, rs->nroots, rs->mm)
+
+#define RSDEC_KERNEL(mm, nroots)					\
+	RSDEC_SYNDROME_FUNCS(syndrome_##mm##_##nroots##_16, uint16_t,	\
+			     nroots, mm)				\
+	RSDEC_SYNDROME_FUNCS(syndrome_##mm##_##nroots##_8, uint8_t,	\
+			     nroots, mm)
+#include RSDEC_KERNELS_DEF
+#undef RSDEC_KERNEL
+
+static const struct rsdec_kernels {
+	int mm;
+	int nroots;
+	struct rsdec_ops ops;
+} kernels[] = {
+#define RSDEC_KERNEL(mm, nroots)					\
+	{ mm, nroots, {							\
+		syndrome_##mm##_##nroots##_16,				\
+		syndrome_##mm##_##nroots##_16_interleaved,		\
+		syndrome_##mm##_##nroots##_8,				\
+		syndrome_##mm##_##nroots##_8_interleaved } },
+#include RSDEC_KERNELS_DEF
+#undef RSDEC_KERNEL
+	/* Any other code */
+	{ 0, 0, {
+		syndrome_generic16,
+		syndrome_generic16_interleaved,
+		syndrome_generic8,
+		syndrome_generic8_interleaved } }
+};
+
+static const struct rsdec_ops *find_kernels(int mm, int nroots)
+{
+	size_t i;
+
+	for (i = 0; kernels[i].mm; i++)
+		if (kernels[i].mm == mm && kernels[i].nroots == nroots)
+			break;
+
+	return &kernels[i].ops;
+}
+
+struct rsdec *rsdec_init(size_t symsize, size_t gfpoly, size_t fcr,
+			 size_t prim, size_t nroots)
+{
+	if (symsize < 2 || symsize > 16)
+		return NULL;
+
+	struct rsdec *rs = calloc(1, sizeof(*rs));
+	if (!rs)
+		return NULL;
+
+	rs->mm = symsize;
+	rs->nn = (1 << symsize) - 1;
+	rs->nroots = nroots;
+	rs->fcr = fcr;
+	rs->prim = prim;
+	rs->gfpoly = gfpoly;
+
+	rs->alpha_to = malloc((rs->nn + 1) * sizeof(*rs->alpha_to));
+	rs->index_of = malloc((rs->nn + 1) * sizeof(*rs->index_of));
+	rs->root = malloc((nroots + 1) * sizeof(*rs->root));
+	rs->genpoly = malloc((nroots + 1) * sizeof(*rs->genpoly));
+	rs->alpha_ext = calloc(3 * rs->nn, sizeof(*rs->alpha_ext));
+	if (!rs->alpha_to || !rs->index_of || !rs->root || !rs->genpoly ||
+	    !rs->alpha_ext)
+		goto err;
+
+	/* Generate Galois field lookup tables */
+	rs->index_of[0] = rs->nn;	/* log(zero) = -inf */
+	rs->alpha_to[rs->nn] = 0;	/* alpha**-inf = 0 */
+	size_t sr = 1;
+	for (int i = 0; i < rs->nn; i++) {
+		rs->index_of[sr] = i;
+		rs->alpha_to[i] = sr;
+		sr <<= 1;
+		if (sr & (1 << symsize))
+			sr ^= gfpoly;
+		sr &= rs->nn;
+	}
+
+	/* If it's not primitive, exit */
+	if (sr != 1)
+		goto err;
+
+	for (int i = 0; i < 2 * rs->nn; i++)
+		rs->alpha_ext[i] = rs->alpha_to[i % rs->nn];
+
+	/* Find prim-th root of 1, used in decoding */
+	int iprim;
+	for (iprim = 1; (iprim % prim) != 0; iprim += rs->nn)
+		;
+	rs->iprim = iprim / prim;
+
+	for (size_t i = 0; i < nroots; i++)
+		rs->root[i] = ((fcr + i) * prim) % rs->nn;
+
+	/* Form the generator polynomial from its roots */
+	uint16_t *genpoly = rs->genpoly;
+	genpoly[0] = 1;
+	for (size_t i = 0; i < nroots; i++) {
+		genpoly[i + 1] = 1;
+		for (size_t j = i; j > 0; j--) {
+			if (genpoly[j] != 0)
+				genpoly[j] = genpoly[j - 1] ^ rs->alpha_to[
+					rsdec_modnn(rs, rs->index_of[genpoly[j]]
+						    + rs->root[i])];
+			else
+				genpoly[j] = genpoly[j - 1];
+		}
+		genpoly[0] = rs->alpha_to[rsdec_modnn(rs,
+				rs->index_of[genpoly[0]] + rs->root[i])];
+	}
+
+	rs->ops = find_kernels(rs->mm, rs->nroots);
+
+	/* The table kernels are as good as the scalar gf kernels */
+	const struct gf_ops *gf = gf_ops_get();
+	if (rs->mm <= 8 && strcmp(gf->name, "scalar")) {
+		rs->gf_root = malloc(nroots * sizeof(*rs->gf_root));
+		rs->gf_gen = malloc((nroots + 1) * sizeof(*rs->gf_gen));
+		if (!rs->gf_root || !rs->gf_gen)
+			goto err;
+
+		for (size_t i = 0; i < nroots; i++)
+			gf_mul_init(&rs->gf_root[i], rs->alpha_to, rs->index_of,
+				    rs->mm, rs->alpha_to[rs->root[i]]);
+		for (size_t i = 0; i <= nroots; i++)
+			gf_mul_init(&rs->gf_gen[i], rs->alpha_to, rs->index_of,
+				    rs->mm, genpoly[i]);
+		rs->gf = gf;
+	}
+
+	return rs;
+
+err:
+	rsdec_free(rs);
+	return NULL;
+}
+
+void rsdec_free(struct rsdec *rs)
+{
+	if (!rs)
+		return;
+
+	free(rs->gf_gen);
+	free(rs->gf_root);
+	free(rs->alpha_ext);
+	free(rs->genpoly);
+	free(rs->root);
+	free(rs->index_of);
+	free(rs->alpha_to);
+	free(rs);
+}
+
+/* The gf kernels do not pay off for fewer interleaved words than this */
+#define RSDEC_GF_MIN_WORDS 16
+/* Words per block in the gf syndrome computations */
+#define RSDEC_GF_BLOCK 256
+/* Words per block when the words have to be interleaved first. The block is
+ * kept small so that the interleaved copy stays in the cache. */
+#define RSDEC_GF_COPY 32
+
+/* The syndromes of n <= RSDEC_GF_BLOCK interleaved words, with symbol j of
+ * word c at data[j * stride + c]. Each root keeps the partial syndromes of
+ * all words in one vector, so that a Horner step is a multiplication of the
+ * vector by the root. */
+static void syndrome_block_gf(const struct rsdec *rs, const uint8_t *data,
+			      size_t len, size_t stride, size_t n,
+			      uint16_t *syn)
+{
+	int nroots = rs->nroots;
+	uint8_t acc[nroots][RSDEC_GF_BLOCK];
+
+	for (int i = 0; i < nroots; i++)
+		memcpy(acc[i], data, n);
+
+	for (size_t j = 1; j < len; j++)
+		for (int i = 0; i < nroots; i++)
+			rs->gf->horner(&rs->gf_root[i], acc[i],
+				       data + j * stride, n);
+
+	for (size_t c = 0; c < n; c++)
+		for (int i = 0; i < nroots; i++)
+			syn[c * nroots + i] = acc[i][c];
+}
+
+void rsdec_syndrome_interleaved8(const struct rsdec *rs, const uint8_t *data,
+				 size_t len, size_t n, uint16_t *syn)
+{
+	if (!rs->gf || n < RSDEC_GF_MIN_WORDS) {
+		rs->ops->syndrome_interleaved8(rs, data, len, n, syn);
+		return;
+	}
+
+	for (size_t c = 0; c < n; c += RSDEC_GF_BLOCK) {
+		size_t w = n - c < RSDEC_GF_BLOCK ? n - c : RSDEC_GF_BLOCK;
+		syndrome_block_gf(rs, data + c, len, n, w,
+				  syn + c * rs->nroots);
+	}
+}
+
+void rsdec_syndrome_words8(const struct rsdec *rs, const uint8_t *data,
+			   size_t len, size_t n, uint16_t *syn)
+{
+	if (!rs->gf || n < RSDEC_GF_MIN_WORDS) {
+		for (size_t c = 0; c < n; c++)
+			rs->ops->syndrome8(rs, data + c * len, len, 1,
+					   syn + c * rs->nroots);
+		return;
+	}
+
+	uint8_t t[len * RSDEC_GF_COPY];
+
+	for (size_t c = 0; c < n; c += RSDEC_GF_COPY) {
+		size_t w = n - c < RSDEC_GF_COPY ? n - c : RSDEC_GF_COPY;
+		for (size_t k = 0; k < w; k++)
+			for (size_t j = 0; j < len; j++)
+				t[j * w + k] = data[(c + k) * len + j];
+
+		syndrome_block_gf(rs, t, len, w, w, syn + c * rs->nroots);
+	}
+}
+
+/* Symbols of LFSR state per block when encoding */
+#define RSDEC_ENC_STATE 16384
+
+/* The parity of the n interleaved words of length len in data, with the gf
+ * kernels. The LFSR state is kept as a ring of nroots vectors, one per parity
+ * symbol, so that no vectors have to be shifted. */
+static void encode_block_gf(const struct rsdec *rs, uint16_t *data,
+			    size_t len, size_t stride, size_t n)
+{
+	int nroots = rs->nroots;
+	const struct gf_mul *gen = rs->gf_gen;
+	uint8_t par[nroots][n], fb[n];
+	int h = 0;
+
+	memset(par, 0, sizeof(par));
+	for (size_t j = 0; j < len - nroots; j++) {
+		const uint16_t *row = data + j * stride;
+		for (size_t c = 0; c < n; c++)
+			fb[c] = row[c] ^ par[h][c];
+
+		for (int k = 0; k < nroots - 1; k++) {
+			int slot = h + 1 + k < nroots ? h + 1 + k : h + 1 + k - nroots;
+			rs->gf->muladd(&gen[nroots - 1 - k], par[slot], fb, n);
+		}
+		rs->gf->mul(&gen[0], par[h], fb, n);
+		h = h + 1 < nroots ? h + 1 : 0;
+	}
+
+	for (int k = 0; k < nroots; k++) {
+		uint16_t *row = data + (len - nroots + k) * stride;
+		int slot = h + k < nroots ? h + k : h + k - nroots;
+		for (size_t c = 0; c < n; c++)
+			row[c] = par[slot][c];
+	}
+}
+
+/* The same with the tables. The feedback of a word is in index form, with
+ * zero as 2 * nn, so that alpha_ext gives the products without branches. */
+static void encode_block_tab(const struct rsdec *rs, uint16_t *data,
+			     size_t len, size_t stride, size_t n)
+{
+	int nn = rs->nn;
+	int nroots = rs->nroots;
+	const uint16_t *alpha_ext = rs->alpha_ext;
+	const uint16_t *index_of = rs->index_of;
+	uint16_t par[nroots][n];
+	uint32_t fb[n];
+	int h = 0;
+
+	memset(par, 0, sizeof(par));
+	for (size_t j = 0; j < len - nroots; j++) {
+		const uint16_t *row = data + j * stride;
+		for (size_t c = 0; c < n; c++) {
+			uint16_t x = row[c] ^ par[h][c];
+			fb[c] = x ? index_of[x] : 2 * nn;
+		}
+
+		for (int k = 0; k < nroots - 1; k++) {
+			int slot = h + 1 + k < nroots ? h + 1 + k : h + 1 + k - nroots;
+			uint16_t g = rs->genpoly[nroots - 1 - k];
+			if (!g)
+				continue;
+
+			const uint16_t *t = alpha_ext + index_of[g];
+			for (size_t c = 0; c < n; c++)
+				par[slot][c] ^= t[fb[c]];
+		}
+
+		const uint16_t *t = alpha_ext + index_of[rs->genpoly[0]];
+		for (size_t c = 0; c < n; c++)
+			par[h][c] = t[fb[c]];
+		h = h + 1 < nroots ? h + 1 : 0;
+	}
+
+	for (int k = 0; k < nroots; k++) {
+		uint16_t *row = data + (len - nroots + k) * stride;
+		int slot = h + k < nroots ? h + k : h + k - nroots;
+		memcpy(row, par[slot], n * sizeof(*row));
+	}
+}
+
+static void encode_block(const struct rsdec *rs, uint16_t *data,
+			 size_t len, size_t stride, size_t n)
+{
+	if (rs->gf)
+		encode_block_gf(rs, data, len, stride, n);
+	else
+		encode_block_tab(rs, data, len, stride, n);
+}
+
+/* The number of words to encode together, which bounds the LFSR state */
+static size_t encode_width(const struct rsdec *rs)
+{
+	size_t w = RSDEC_ENC_STATE / rs->nroots;
+	return w < 1 ? 1 : w < RSDEC_GF_BLOCK ? w : RSDEC_GF_BLOCK;
+}
+
+void rsdec_encode_interleaved(const struct rsdec *rs, uint16_t *data,
+			      size_t len, size_t n, size_t stride)
+{
+	size_t bw = encode_width(rs);
+
+	for (size_t c = 0; c < n; c += bw) {
+		size_t w = n - c < bw ? n - c : bw;
+		encode_block(rs, data + c, len, stride, w);
+	}
+}
+
+void rsdec_encode_words(const struct rsdec *rs, uint16_t *data,
+			size_t len, size_t n)
+{
+	size_t dlen = len - rs->nroots;
+	size_t bw = encode_width(rs);
+
+	if (bw > RSDEC_GF_COPY)
+		bw = RSDEC_GF_COPY;
+	if (bw > RSDEC_ENC_STATE / len)
+		bw = RSDEC_ENC_STATE / len;
+
+	/* Words too long to copy are encoded one at a time, in place */
+	if (bw < 2) {
+		for (size_t c = 0; c < n; c++)
+			encode_block(rs, data + c * len, len, 1, 1);
+		return;
+	}
+
+	uint16_t t[len * bw];
+	for (size_t c = 0; c < n; c += bw) {
+		size_t w = n - c < bw ? n - c : bw;
+		uint16_t *d = data + c * len;
+
+		for (size_t k = 0; k < w; k++)
+			for (size_t j = 0; j < dlen; j++)
+				t[j * w + k] = d[k * len + j];
+
+		encode_block(rs, t, len, w, w);
+
+		for (size_t k = 0; k < w; k++)
+			for (size_t j = dlen; j < len; j++)
+				d[k * len + j] = t[j * w + k];
+	}
+}
+
+void rsdec_syn_update(const struct rsdec *rs, uint16_t *syn,
+		      size_t len, size_t pos, uint16_t val)
+{
+	int nn = rs->nn;
+	int loc = rs->index_of[val];
+	int step = ((unsigned long) rs->prim * (len - 1 - pos)) % nn;
+	int x = ((unsigned long) rs->fcr * step) % nn;
+
+	for (int i = 0; i < rs->nroots; i++) {
+		syn[i] ^= rs->alpha_to[rsdec_modnn(rs, loc + x)];
+		x = rsdec_modnn(rs, x + step);
+	}
+}
+
+/* The locator of position pos of a full length codeword, in index form */
+static inline int eras_loc(const struct rsdec *rs, int pos)
+{ return ((unsigned long) rs->prim * (rs->nn - 1 - pos)) % rs->nn; }
+
+void rsdec_eras_locator(const struct rsdec *rs, size_t len, const int *eras,
+			int no_eras, uint16_t *lambda)
+{
+	const uint16_t *alpha_to = rs->alpha_to;
+	const uint16_t *index_of = rs->index_of;
+	int pad = rs->nn - len;
+
+	memset(&lambda[1], 0, rs->nroots * sizeof(lambda[0]));
+	lambda[0] = 1;
+
+	if (no_eras <= 0)
+		return;
+
+	lambda[1] = alpha_to[eras_loc(rs, eras[0] + pad)];
+	for (int i = 1; i < no_eras; i++) {
+		int u = eras_loc(rs, eras[i] + pad);
+		for (int j = i + 1; j > 0; j--) {
+			int tmp = index_of[lambda[j - 1]];
+			if (tmp != rs->nn)
+				lambda[j] ^= alpha_to[rsdec_modnn(rs, u + tmp)];
+		}
+	}
+}
+
+/* Positions per block in the gf Chien search */
+#define RSDEC_CHIEN_BLOCK 64
+
+/*
+ * Chien search with the gf kernels. Lane t of reg[j] holds term j of p at
+ * the point t of the current block, so that moving to the next block is a
+ * multiplication of each reg[j] by a constant.
+ */
+static int chien_search_gf(const struct rsdec *rs, const uint16_t *p,
+			   int deg, int start, int step, int cnt,
+			   int *ts, int max)
+{
+	int nn = rs->nn;
+	const uint16_t *alpha_to = rs->alpha_to;
+	uint8_t reg[deg + 1][RSDEC_CHIEN_BLOCK], sum[RSDEC_CHIEN_BLOCK];
+	struct gf_mul k[deg + 1];
+	int count = 0;
+
+	for (int j = 1; j <= deg; j++) {
+		memset(reg[j], 0, RSDEC_CHIEN_BLOCK);
+		if (p[j] == nn)
+			continue;
+
+		int e = rsdec_modnn(rs, p[j] + ((unsigned long) j * start) % nn);
+		int d = ((unsigned long) j * step) % nn;
+		for (int t = 0; t < RSDEC_CHIEN_BLOCK; t++) {
+			reg[j][t] = alpha_to[e];
+			e = rsdec_modnn(rs, e + d);
+		}
+		gf_mul_init(&k[j], alpha_to, rs->index_of, rs->mm, alpha_to[
+			((unsigned long) d * RSDEC_CHIEN_BLOCK) % nn]);
+	}
+
+	for (int t0 = 0; t0 < cnt; t0 += RSDEC_CHIEN_BLOCK) {
+		int n = cnt - t0 < RSDEC_CHIEN_BLOCK ? cnt - t0 : RSDEC_CHIEN_BLOCK;
+
+		memset(sum, 1, n);	/* p[0] is always 0 */
+		for (int j = 1; j <= deg; j++) {
+			if (p[j] == nn)
+				continue;
+			for (int t = 0; t < n; t++)
+				sum[t] ^= reg[j][t];
+			rs->gf->mul(&k[j], reg[j], reg[j], RSDEC_CHIEN_BLOCK);
+		}
+
+		for (uint8_t *z = memchr(sum, 0, n); z;
+		     z = memchr(z + 1, 0, n - (z + 1 - sum))) {
+			ts[count] = t0 + (z - sum);
+			if (++count == max)
+				return count;
+		}
+	}
+
+	return count;
+}
+
+/*
+ * Finds the t in [0, cnt) for which p(alpha^(start + t * step)) = 0, where p
+ * is a polynomial of degree deg in index form with p[0] = 0. The search stops
+ * after max roots. Returns the number of roots found.
+ */
+static int chien_search(const struct rsdec *rs, const uint16_t *p, int deg,
+			int start, int step, int cnt, int *ts, int max)
+{
+	int nn = rs->nn;
+	const uint16_t *alpha_to = rs->alpha_to;
+	uint16_t reg[deg + 1], inc[deg + 1];
+	int count = 0;
+
+	if (rs->gf && cnt >= RSDEC_CHIEN_BLOCK)
+		return chien_search_gf(rs, p, deg, start, step, cnt, ts, max);
+
+	for (int j = 1; j <= deg; j++) {
+		reg[j] = p[j] == nn ? nn :
+			rsdec_modnn(rs, p[j] + ((unsigned long) j * start) % nn);
+		inc[j] = ((unsigned long) j * step) % nn;
+	}
+
+	for (int t = 0; t < cnt; t++) {
+		int q = 1;	/* p[0] is always 0 */
+		for (int j = deg; j > 0; j--) {
+			if (reg[j] != nn) {
+				q ^= alpha_to[reg[j]];
+				reg[j] = rsdec_modnn(rs, reg[j] + inc[j]);
+			}
+		}
+		if (q != 0)
+			continue;
+
+		ts[count] = t;
+		if (++count == max)
+			break;
+	}
+
+	return count;
+}
+
+int rsdec_decode(const struct rsdec *rs, const uint16_t *syn, size_t len,
+		 const int *eras, int no_eras, int *errpos, uint16_t *errval)
+{
+	uint16_t lambda[rs->nroots + 1];
+
+	if (no_eras > rs->nroots)
+		return -1;
+
+	if (rsdec_syn_zero(rs, syn))
+		return 0;
+
+	rsdec_eras_locator(rs, len, eras, no_eras, lambda);
+	return rsdec_decode_lambda(rs, syn, len, lambda, no_eras,
+				   errpos, errval);
+}
+
+int rsdec_decode_lambda(const struct rsdec *rs, const uint16_t *syn,
+			size_t len, const uint16_t *eras_lambda, int no_eras,
+			int *errpos, uint16_t *errval)
+{
+	int nn = rs->nn;
+	int nroots = rs->nroots;
+	int fcr = rs->fcr;
+	int iprim = rs->iprim;
+	const uint16_t *alpha_to = rs->alpha_to;
+	const uint16_t *index_of = rs->index_of;
+	int pad = nn - len;
+	uint16_t s[nroots], lambda[nroots + 1], b[nroots + 1], t[nroots + 1];
+	uint16_t omega[nroots + 1], root[nroots];
+	uint16_t loc[nroots], cor[nroots];
+	int ts[nroots];
+	int deg_lambda, el, deg_omega, count;
+	int syn_error = 0;
+
+	if (no_eras > nroots)
+		return -1;
+
+	/* Convert syndromes to index form */
+	for (int i = 0; i < nroots; i++) {
+		syn_error |= syn[i];
+		s[i] = index_of[syn[i]];
+	}
+
+	if (!syn_error)
+		return 0;
+
+	/* Init lambda to be the erasure locator polynomial */
+	memcpy(lambda, eras_lambda, (nroots + 1) * sizeof(lambda[0]));
+
+	for (int i = 0; i < nroots + 1; i++)
+		b[i] = index_of[lambda[i]];
+
+	/*
+	 * Begin Berlekamp-Massey algorithm to determine error+erasure
+	 * locator polynomial
+	 */
+	int r = no_eras;
+	el = no_eras;
+	while (++r <= nroots) {
+		/* Compute discrepancy at the r-th step in poly-form */
+		int discr_r = 0;
+		for (int i = 0; i < r; i++) {
+			if ((lambda[i] != 0) && (s[r - i - 1] != nn))
+				discr_r ^= alpha_to[rsdec_modnn(rs,
+					index_of[lambda[i]] + s[r - i - 1])];
+		}
+		discr_r = index_of[discr_r];	/* Index form */
+		if (discr_r == nn) {
+			/* 2 lines below: B(x) <-- x*B(x) */
+			memmove(&b[1], b, nroots * sizeof(b[0]));
+			b[0] = nn;
+		} else {
+			/* 7 lines below: T(x) <-- lambda(x)-discr_r*x*b(x) */
+			t[0] = lambda[0];
+			for (int i = 0; i < nroots; i++) {
+				if (b[i] != nn)
+					t[i + 1] = lambda[i + 1] ^ alpha_to[
+						rsdec_modnn(rs, discr_r + b[i])];
+				else
+					t[i + 1] = lambda[i + 1];
+			}
+			if (2 * el <= r + no_eras - 1) {
+				el = r + no_eras - el;
+				/* 2 lines below: B(x) <-- inv(discr_r) * lambda(x) */
+				for (int i = 0; i <= nroots; i++)
+					b[i] = (lambda[i] == 0) ? nn :
+						rsdec_modnn(rs, index_of[lambda[i]]
+							    - discr_r + nn);
+			} else {
+				/* 2 lines below: B(x) <-- x*B(x) */
+				memmove(&b[1], b, nroots * sizeof(b[0]));
+				b[0] = nn;
+			}
+			memcpy(lambda, t, (nroots + 1) * sizeof(t[0]));
+		}
+	}
+
+	/* Convert lambda to index form and compute deg(lambda(x)) */
+	deg_lambda = 0;
+	for (int i = 0; i < nroots + 1; i++) {
+		lambda[i] = index_of[lambda[i]];
+		if (lambda[i] != nn)
+			deg_lambda = i;
+	}
+
+	/* deg(lambda) is zero even though the syndrome is non-zero */
+	if (deg_lambda == 0)
+		return -1;
+
+	/* Find roots of error+erasure locator polynomial by Chien search,
+	 * over alpha^i for i = 1, ..., nn */
+	count = chien_search(rs, lambda, deg_lambda, 1, 1, nn, ts, deg_lambda);
+	for (int j = 0; j < count; j++) {
+		int i = ts[j] + 1;
+		int k = ((unsigned long) i * iprim + nn - 1) % nn;
+
+		/* Impossible error location */
+		if (k < pad)
+			return -1;
+
+		root[j] = i;
+		loc[j] = k;
+	}
+
+	/* deg(lambda) unequal to number of roots => uncorrectable error */
+	if (deg_lambda != count)
+		return -1;
+
+	/*
+	 * Compute err+eras evaluator poly omega(x) = s(x)*lambda(x) (modulo
+	 * x**nroots). in index form. Also find deg(omega).
+	 */
+	deg_omega = deg_lambda - 1;
+	for (int i = 0; i <= deg_omega; i++) {
+		int tmp = 0;
+		for (int j = i; j >= 0; j--) {
+			if ((s[i - j] != nn) && (lambda[j] != nn))
+				tmp ^= alpha_to[rsdec_modnn(rs, s[i - j] + lambda[j])];
+		}
+		omega[i] = index_of[tmp];
+	}
+
+	/*
+	 * Compute error values in poly-form. num1 = omega(inv(X(l))), num2 =
+	 * inv(X(l))**(fcr-1) and den = lambda_pr(inv(X(l))) all in poly-form
+	 */
+	for (int j = count - 1; j >= 0; j--) {
+		int num1 = 0;
+		for (int i = deg_omega; i >= 0; i--) {
+			if (omega[i] != nn)
+				num1 ^= alpha_to[rsdec_modnn(rs, omega[i] + i * root[j])];
+		}
+
+		if (num1 == 0) {
+			cor[j] = 0;
+			continue;
+		}
+
+		int num2 = alpha_to[((unsigned long) root[j] * (fcr - 1 + nn)) % nn];
+		int den = 0;
+
+		/* lambda[i+1] for i even is the formal derivative lambda_pr
+		 * of lambda[i] */
+		int max = deg_lambda < nroots - 1 ? deg_lambda : nroots - 1;
+		for (int i = max & ~1; i >= 0; i -= 2) {
+			if (lambda[i + 1] != nn)
+				den ^= alpha_to[rsdec_modnn(rs, lambda[i + 1] + i * root[j])];
+		}
+
+		cor[j] = alpha_to[rsdec_modnn(rs, index_of[num1] +
+					      index_of[num2] + nn -
+					      index_of[den])];
+	}
+
+	int ncorr = 0;
+	for (int i = 0; i < count; i++) {
+		if (!cor[i])
+			continue;
+
+		errpos[ncorr] = loc[i] - pad;
+		errval[ncorr] = cor[i];
+		ncorr++;
+	}
+
+	return ncorr;
+}
+
+void rsdec_forney_syndromes(const struct rsdec *rs, const uint16_t *syn,
+			    const uint16_t *lambda, uint16_t *fsyn)
+{
+	const uint16_t *alpha_to = rs->alpha_to;
+	const uint16_t *index_of = rs->index_of;
+
+	for (int i = 0; i < rs->nroots; i++) {
+		int tmp = 0;
+		for (int j = 0; j <= i; j++) {
+			if (lambda[j] && syn[i - j])
+				tmp ^= alpha_to[rsdec_modnn(rs,
+					index_of[lambda[j]] + index_of[syn[i - j]])];
+		}
+		fsyn[i] = tmp;
+	}
+}
+
+void rsdec_forney_add_erasures(const struct rsdec *rs, uint16_t *fsyn,
+			       size_t len, const int *eras, int no_eras)
+{
+	const uint16_t *alpha_to = rs->alpha_to;
+	const uint16_t *index_of = rs->index_of;
+	int pad = rs->nn - len;
+
+	/* fsyn(x) <-- fsyn(x) * (1 + X * x) mod x^nroots */
+	for (int i = 0; i < no_eras; i++) {
+		int u = eras_loc(rs, eras[i] + pad);
+		for (int j = rs->nroots - 1; j > 0; j--) {
+			if (fsyn[j - 1])
+				fsyn[j] ^= alpha_to[rsdec_modnn(rs,
+					u + index_of[fsyn[j - 1]])];
+		}
+	}
+}
+
+int rsdec_decode_forney(const struct rsdec *rs, const uint16_t *fsyn,
+			size_t len, const int *eras, const uint16_t *eras_lambda,
+			int no_eras, int *errpos, uint16_t *errval)
+{
+	int nn = rs->nn;
+	int nroots = rs->nroots;
+	int fcr = rs->fcr;
+	int prim = rs->prim;
+	const uint16_t *alpha_to = rs->alpha_to;
+	const uint16_t *index_of = rs->index_of;
+	int pad = nn - len;
+	uint16_t t[nroots], sigma[nroots + 1], b[nroots + 1], tmp[nroots + 1];
+	uint16_t psi[nroots + 1], omega[nroots];
+	int ts[nroots];
+	uint16_t root[nroots], loc[nroots], sroot[nroots], sloc[nroots];
+	int deg_sigma, deg_psi, el, count, nsroots;
+	int syn_error = 0;
+
+	if (no_eras > nroots)
+		return -1;
+
+	/* Convert the Forney syndromes to index form */
+	for (int i = 0; i < nroots; i++) {
+		syn_error |= fsyn[i];
+		t[i] = index_of[fsyn[i]];
+	}
+
+	if (!syn_error)
+		return 0;
+
+	/*
+	 * Berlekamp-Massey on the Forney syndromes t[no_eras..nroots-1]. This
+	 * is the same iteration as in rsdec_decode_lambda, but for the error
+	 * locator sigma alone, which is lambda / eras_lambda.
+	 */
+	memset(sigma, 0, (nroots + 1) * sizeof(sigma[0]));
+	sigma[0] = 1;
+	for (int i = 0; i < nroots + 1; i++)
+		b[i] = index_of[sigma[i]];
+
+	el = 0;
+	for (int r = 1; r <= nroots - no_eras; r++) {
+		/* Compute discrepancy at the r-th step in poly-form */
+		int discr_r = 0;
+		for (int i = 0; i < r; i++) {
+			if ((sigma[i] != 0) && (t[no_eras + r - i - 1] != nn))
+				discr_r ^= alpha_to[rsdec_modnn(rs,
+					index_of[sigma[i]] +
+					t[no_eras + r - i - 1])];
+		}
+		discr_r = index_of[discr_r];	/* Index form */
+		if (discr_r == nn) {
+			memmove(&b[1], b, nroots * sizeof(b[0]));
+			b[0] = nn;
+		} else {
+			tmp[0] = sigma[0];
+			for (int i = 0; i < nroots; i++) {
+				if (b[i] != nn)
+					tmp[i + 1] = sigma[i + 1] ^ alpha_to[
+						rsdec_modnn(rs, discr_r + b[i])];
+				else
+					tmp[i + 1] = sigma[i + 1];
+			}
+			if (2 * el <= r - 1) {
+				el = r - el;
+				for (int i = 0; i <= nroots; i++)
+					b[i] = (sigma[i] == 0) ? nn :
+						rsdec_modnn(rs, index_of[sigma[i]]
+							    - discr_r + nn);
+			} else {
+				memmove(&b[1], b, nroots * sizeof(b[0]));
+				b[0] = nn;
+			}
+			memcpy(sigma, tmp, (nroots + 1) * sizeof(tmp[0]));
+		}
+	}
+
+	deg_sigma = 0;
+	for (int i = 0; i < nroots + 1; i++)
+		if (sigma[i])
+			deg_sigma = i;
+
+	deg_psi = no_eras + deg_sigma;
+	if (deg_psi == 0 || deg_psi > nroots)
+		return -1;
+
+	/* Errata locator psi(x) = eras_lambda(x) * sigma(x), in index form */
+	for (int i = 0; i <= nroots; i++) {
+		int sum = 0;
+		int lo = i - deg_sigma > 0 ? i - deg_sigma : 0;
+		int hi = i < no_eras ? i : no_eras;
+		for (int j = lo; j <= hi; j++) {
+			if (eras_lambda[j] && sigma[i - j])
+				sum ^= alpha_to[rsdec_modnn(rs,
+					index_of[eras_lambda[j]] +
+					index_of[sigma[i - j]])];
+		}
+		psi[i] = index_of[sum];
+	}
+
+	/*
+	 * Chien search for the roots of sigma over the positions of the word.
+	 * A root in the padding, or at an erasure, is an uncorrectable error.
+	 * Position k of the full length code is the root alpha^((k + 1) * prim).
+	 */
+	for (int j = 0; j <= deg_sigma; j++)
+		sigma[j] = index_of[sigma[j]];
+
+	nsroots = 0;
+	if (deg_sigma > 0) {
+		int x0 = ((unsigned long) (pad + 1) * prim) % nn;
+		nsroots = chien_search(rs, sigma, deg_sigma, x0, prim, nn - pad,
+				       ts, deg_sigma);
+		if (nsroots != deg_sigma)
+			return -1;
+
+		for (int j = 0; j < nsroots; j++) {
+			int k = pad + ts[j];
+			sroot[j] = ((unsigned long) (k + 1) * prim) % nn;
+			sloc[j] = k;
+		}
+	}
+
+	/* Merge the erasures and the roots of sigma in position order */
+	count = 0;
+	for (int i = 0, j = 0; i < no_eras || j < nsroots;) {
+		int k = i < no_eras ? eras[i] + pad : nn;
+		if (j < nsroots && sloc[j] == k)
+			return -1;
+		if (j < nsroots && sloc[j] < k) {
+			root[count] = sroot[j];
+			loc[count++] = sloc[j++];
+		} else {
+			root[count] = ((unsigned long) (k + 1) * prim) % nn;
+			loc[count++] = k;
+			i++;
+		}
+	}
+
+	/* omega(x) = t(x) * sigma(x) mod x^nroots, in index form */
+	int deg_omega = deg_psi - 1;
+	for (int i = 0; i <= deg_omega; i++) {
+		int sum = 0;
+		int lo = i - deg_sigma > 0 ? i - deg_sigma : 0;
+		for (int j = lo; j <= i; j++) {
+			if ((t[j] != nn) && (sigma[i - j] != nn))
+				sum ^= alpha_to[rsdec_modnn(rs, t[j] + sigma[i - j])];
+		}
+		omega[i] = index_of[sum];
+	}
+
+	/* Forney's algorithm, as in rsdec_decode_lambda */
+	int ncorr = 0;
+	for (int j = 0; j < count; j++) {
+		int num1 = 0;
+		for (int i = deg_omega; i >= 0; i--) {
+			if (omega[i] != nn)
+				num1 ^= alpha_to[rsdec_modnn(rs, omega[i] + i * root[j])];
+		}
+
+		if (num1 == 0)
+			continue;
+
+		int num2 = alpha_to[((unsigned long) root[j] * (fcr - 1 + nn)) % nn];
+		int den = 0;
+
+		int max = deg_psi < nroots - 1 ? deg_psi : nroots - 1;
+		for (int i = max & ~1; i >= 0; i -= 2) {
+			if (psi[i + 1] != nn)
+				den ^= alpha_to[rsdec_modnn(rs, psi[i + 1] + i * root[j])];
+		}
+
+		errpos[ncorr] = loc[j] - pad;
+		errval[ncorr] = alpha_to[rsdec_modnn(rs, index_of[num1] +
+						     index_of[num2] + nn -
+						     index_of[den])];
+		ncorr++;
+	}
+
+	return ncorr;
+}
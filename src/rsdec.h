@@ -0,0 +1,189 @@
+/*
+ * rsdec.h
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#ifndef FB_PCDECODE_RSDEC_H
+#define FB_PCDECODE_RSDEC_H
+
+#include "gf.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Reed-Solomon decoding from syndromes. The codes, and the positions in a
+ * codeword, are the same as for librs: a word of length len is a shortened
+ * codeword whose first symbol is the coefficient of x^(len - 1).
+ *
+ * Unlike rs_decode these functions never touch the codeword. The decoder
+ * reports the error positions and values, and it is up to the caller to apply
+ * them and to keep the syndromes up to date.
+ */
+struct rsdec;
+
+/* Kernels that rsdec_init selects for the parameters of the code */
+struct rsdec_ops {
+	void (*syndrome)(const struct rsdec *rs, const uint16_t *data,
+			 size_t len, size_t stride, uint16_t *syn);
+	void (*syndrome_interleaved)(const struct rsdec *rs,
+				     const uint16_t *data, size_t len,
+				     size_t n, uint16_t *syn);
+	void (*syndrome8)(const struct rsdec *rs, const uint8_t *data,
+			  size_t len, size_t stride, uint16_t *syn);
+	void (*syndrome_interleaved8)(const struct rsdec *rs,
+				      const uint8_t *data, size_t len,
+				      size_t n, uint16_t *syn);
+};
+
+struct rsdec {
+	int mm;			/* Bits per symbol */
+	int nn;			/* Symbols per block (= (1<<mm)-1) */
+	int nroots;		/* Number of generator roots */
+	int fcr;		/* First consecutive root, index form */
+	int prim;		/* Primitive element, index form */
+	int iprim;		/* prim-th root of 1, index form */
+	int gfpoly;		/* field generator polynomial */
+	uint16_t *alpha_to;	/* index form -> polynomial form */
+	uint16_t *index_of;	/* polynomial form -> index form */
+	uint16_t *alpha_ext;	/* alpha_to for [0, 2 * nn), zero above */
+	uint16_t *root;		/* generator roots, index form */
+	uint16_t *genpoly;	/* generator polynomial, polynomial form */
+	const struct rsdec_ops *ops;
+	const struct gf_ops *gf;	/* SIMD kernels, NULL if not used */
+	struct gf_mul *gf_root;	/* the roots for the gf kernels */
+	struct gf_mul *gf_gen;	/* genpoly for the gf kernels */
+};
+
+struct rsdec *rsdec_init(size_t symsize, size_t gfpoly, size_t fcr,
+			 size_t prim, size_t nroots);
+
+void rsdec_free(struct rsdec *rs);
+
+static inline int rsdec_modnn(const struct rsdec *rs, int x)
+{
+	while (x >= rs->nn) {
+		x -= rs->nn;
+		x = (x >> rs->mm) + (x & rs->nn);
+	}
+	return x;
+}
+
+/* Computes the syndromes of data, in polynomial form, into syn. */
+static inline void rsdec_syndrome(const struct rsdec *rs, const uint16_t *data,
+				  size_t len, size_t stride, uint16_t *syn)
+{ rs->ops->syndrome(rs, data, len, stride, syn); }
+
+/* Computes the syndromes of the n interleaved words of length len in data,
+ * where symbol j of word c is data[j * n + c]. The syndromes of word c are
+ * stored at syn + c * nroots. The data is read in memory order, which makes
+ * this the fast way to compute the syndromes of all columns of a word. */
+static inline void rsdec_syndrome_interleaved(const struct rsdec *rs,
+					      const uint16_t *data, size_t len,
+					      size_t n, uint16_t *syn)
+{ rs->ops->syndrome_interleaved(rs, data, len, n, syn); }
+
+/* The same for words stored with one symbol per byte, for symsize <= 8 */
+static inline void rsdec_syndrome8(const struct rsdec *rs, const uint8_t *data,
+				   size_t len, size_t stride, uint16_t *syn)
+{ rs->ops->syndrome8(rs, data, len, stride, syn); }
+
+void rsdec_syndrome_interleaved8(const struct rsdec *rs, const uint8_t *data,
+				 size_t len, size_t n, uint16_t *syn);
+
+/* Computes the syndromes of the n words of length len stored one after the
+ * other in data. The syndromes of word c are stored at syn + c * nroots. */
+void rsdec_syndrome_words8(const struct rsdec *rs, const uint8_t *data,
+			   size_t len, size_t n, uint16_t *syn);
+
+/*
+ * Systematic encoding. The last nroots symbols of each word are set to the
+ * parity of the others, exactly as rs_encode does. The words are encoded in
+ * lockstep, with one LFSR step for all of them per symbol position.
+ */
+
+/* Encodes the n interleaved words of length len in data, where symbol j of
+ * word c is data[j * stride + c]. */
+void rsdec_encode_interleaved(const struct rsdec *rs, uint16_t *data,
+			      size_t len, size_t n, size_t stride);
+
+/* Encodes the n words of length len stored one after the other in data */
+void rsdec_encode_words(const struct rsdec *rs, uint16_t *data,
+			size_t len, size_t n);
+
+/* Adds the contribution of the error value val at position pos of a word of
+ * length len to the syndromes in syn. */
+void rsdec_syn_update(const struct rsdec *rs, uint16_t *syn,
+		      size_t len, size_t pos, uint16_t val);
+
+static inline int rsdec_syn_zero(const struct rsdec *rs, const uint16_t *syn)
+{
+	for (int i = 0; i < rs->nroots; i++)
+		if (syn[i])
+			return 0;
+	return 1;
+}
+
+/*
+ * Decodes a word of length len from its syndromes and the no_eras erasures
+ * in eras. The positions and values of the nonzero corrections are stored in
+ * errpos and errval. Returns the number of corrections, or -1 if the word
+ * could not be decoded.
+ */
+int rsdec_decode(const struct rsdec *rs, const uint16_t *syn, size_t len,
+		 const int *eras, int no_eras, int *errpos, uint16_t *errval);
+
+/* Computes the erasure locator polynomial, in polynomial form, of the no_eras
+ * erasures in eras for words of length len. The polynomial has nroots + 1
+ * coefficients and depends only on the erasures, so it can be shared by all
+ * words decoded with the same erasures. */
+void rsdec_eras_locator(const struct rsdec *rs, size_t len, const int *eras,
+			int no_eras, uint16_t *lambda);
+
+/* Like rsdec_decode, but with the erasures given by their locator polynomial
+ * from rsdec_eras_locator. */
+int rsdec_decode_lambda(const struct rsdec *rs, const uint16_t *syn,
+			size_t len, const uint16_t *eras_lambda, int no_eras,
+			int *errpos, uint16_t *errval);
+
+/*
+ * Errors-and-erasures decoding from Forney syndromes, for decoding the same
+ * word with a growing set of erasures. The Forney syndromes are the
+ * coefficients of S(x) * lambda(x) mod x^nroots, where lambda is the erasure
+ * locator, so adding an erasure only multiplies them by one more factor
+ * instead of starting over from the syndromes.
+ */
+
+/* Computes the Forney syndromes fsyn from the syndromes syn and the erasure
+ * locator lambda from rsdec_eras_locator. */
+void rsdec_forney_syndromes(const struct rsdec *rs, const uint16_t *syn,
+			    const uint16_t *lambda, uint16_t *fsyn);
+
+/* Adds the no_eras erasures in eras to the Forney syndromes in fsyn. */
+void rsdec_forney_add_erasures(const struct rsdec *rs, uint16_t *fsyn,
+			       size_t len, const int *eras, int no_eras);
+
+/* Like rsdec_decode_lambda, but from the Forney syndromes of the erasures.
+ * The erasures in eras must be in increasing order. Only the error locator
+ * is solved for and searched, since the roots of the erasure locator are
+ * already known. */
+int rsdec_decode_forney(const struct rsdec *rs, const uint16_t *fsyn,
+			size_t len, const int *eras, const uint16_t *eras_lambda,
+			int no_eras, int *errpos, uint16_t *errval);
+
+#endif /* FB_PCDECODE_RSDEC_H */
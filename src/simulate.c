@@ -23,6 +23,8 @@
 #include "gen_errors.h"
 #include "algorithm.h"
 #include "rng.h"
+#include "perf_counters.h"
+#include "trial_trace.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -33,23 +35,48 @@
 
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
 
+/* The phases of a trial, timed with --timing */
+enum phase {
+	PHASE_MSG,		/* gen_random_msg */
+	PHASE_ENCODE,		/* pc_encode */
+	PHASE_CHANNEL,		/* the channel, and interleaving for batches */
+	PHASE_DECODE,
+	PHASE_CHECK,		/* comparing with the codeword sent */
+	NPHASES
+};
+
 struct wspace {
-	uint16_t *c;            /* sent codeword */
-	uint16_t *r;            /* received word */
+	uint16_t *c;            /* sent codewords */
+	uint16_t *r;            /* received words */
+	uint16_t *b;            /* received words, interleaved */
+	uint8_t *eras;          /* erasures flagged by the channel */
 };
 
 struct thread_args {
 	int (*decode)(struct pc *, uint16_t *, struct stats *);
+	batch_alg_ptr decode_batch;
 	struct pc *pc;
+	struct pc_batch *batch;
+	size_t width;
 	struct wspace *ws;
 	gsl_rng *rng;
 	struct stats s;
 	size_t trials;
 	size_t min_errs;
 	double p;
+	double p_eras;
+	int timing;
+	double t[NPHASES];	/* seconds spent in each phase */
+	int counters;
+	struct perf_counters pf;	/* of the decoding */
+	struct trace *trace;
+	uint32_t *tpos;		/* error pattern of the trial traced */
+	uint16_t *tval;
 };
 
-static struct wspace *alloc_ws(int len)
+/* Allocates room for width words of length len, and for the erasures of a
+ * word if eras is set */
+static struct wspace *alloc_ws(size_t len, size_t width, int eras)
 {
 	struct wspace *ws;
 
@@ -57,11 +84,19 @@ static struct wspace *alloc_ws(int len)
 	if (!ws)
 		return NULL;
 
-	ws->c = malloc(2 * len * sizeof(*ws->c));
+	ws->c = malloc(3 * width * len * sizeof(*ws->c));
 	if (!ws->c)
 		goto err;
 
-	ws->r = ws->c + len;
+	ws->r = ws->c + width * len;
+	ws->b = ws->r + width * len;
+
+	if (eras) {
+		ws->eras = malloc((len + 7) / 8);
+		if (!ws->eras)
+			goto err;
+	}
+
 	return ws;
 
 err:
@@ -75,13 +110,15 @@ static void free_ws(struct wspace *ws)
 	if (!ws)
 		return;
 
+	free(ws->eras);
 	free(ws->c);
 	free(ws);
 }
 
 static void print_start(FILE *file, struct pc *pc,
 			const char *prefix, unsigned long seed,
-			size_t nthreads, const char *alg)
+			size_t nthreads, size_t width, double p_eras,
+			int timing, int counters, const char *alg)
 {
 	static const char *const col_heads[] = {
 		"channel error probability",
@@ -97,22 +134,153 @@ static void print_start(FILE *file, struct pc *pc,
 		"reported failures",
 		"critical failures",
 	};
+	static const char *const timing_heads[] = {
+		"seconds generating messages",
+		"seconds encoding",
+		"seconds in the channel",
+		"seconds decoding",
+		"seconds checking",
+		"codewords per second",
+		"decoded Mbit/s per core",
+	};
 
 	pc_print(file, pc, prefix);
 	fprintf(file, "%sAlgorithm: %s\n", prefix, alg);
 	fprintf(file, "%sSeed: %lu\n", prefix, seed);
 	fprintf(file, "%sThreads: %zu\n", prefix, nthreads);
+	fprintf(file, "%sParallelism: %s\n", prefix,
+		pc->nthreads > 1 ? "within codewords" : "across codewords");
+	if (width > 1)
+		fprintf(file, "%sBatch: %zu\n", prefix, width);
+	if (p_eras > 0)
+		fprintf(file, "%sErasures: %g\n", prefix, p_eras);
+	if (counters) {
+		struct perf_counters pf;
+		int n = perf_counters_open(&pf);
+
+		perf_counters_close(&pf);
+		fprintf(file, "%sHardware counters: %d of %d available%s\n",
+			prefix, n, PERF_NCOUNTERS, pc->nthreads > 1
+			? ", in the thread that starts each codeword" : "");
+	}
 	for (size_t i = 0; i < ARRAY_SIZE(col_heads); i++)
 		fprintf(file, "%s(%zu) %s\n", prefix, i + 1, col_heads[i]);
+	for (size_t i = 0; timing && i < ARRAY_SIZE(timing_heads); i++)
+		fprintf(file, "%s(%zu) %s\n", prefix,
+			ARRAY_SIZE(col_heads) + i + 1, timing_heads[i]);
+	if (counters)
+		perf_counters_print_heads(file, prefix, ARRAY_SIZE(col_heads) +
+					  (timing ? ARRAY_SIZE(timing_heads) : 0)
+					  + 1);
 }
 
 static void print_stats(FILE *file, struct stats *s, double p, size_t ecount)
 {
-	fprintf(file, "%f %zu %zu %zu %zu %zu %zu %zu %zu %zu %zu %zu\n",
+	fprintf(file, "%f %zu %zu %zu %zu %zu %zu %zu %zu %zu %zu %zu",
 		p, s->nwords, s->alg2, s->alg3,
 		s->viable, s->max, s->rdec, s->rdec_max,
 		s->cdec, ecount, s->rfail, s->cfail);
-	fflush(file);
+}
+
+/* The timing columns. The phases are summed over the threads, the rate of
+ * codewords is over the wall time wall and the bit rate is that of the
+ * message bits over the time the cores spent decoding. */
+static void print_timing(FILE *file, const struct pc *pc, const double *t,
+			 size_t nwords, double wall)
+{
+	double bits = (double) nwords * pc_dim(pc) * pc->row_dec->mm;
+
+	for (int i = 0; i < NPHASES; i++)
+		fprintf(file, " %.6f", t[i]);
+	fprintf(file, " %.1f %.3f", nwords / wall,
+		bits / (t[PHASE_DECODE] * pc->nthreads) / 1E6);
+}
+
+static inline double now(void)
+{
+	struct timespec tp;
+
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return tp.tv_sec + tp.tv_nsec * 1E-9;
+}
+
+/* Ends phase ph, which started at *t, and starts the next. The phases share
+ * their boundaries, so a trial costs one clock read per phase. */
+static inline void phase_end(struct thread_args *args, enum phase ph,
+			     double *t)
+{
+	if (!args->timing)
+		return;
+
+	double t1 = now();
+	args->t[ph] += t1 - *t;
+	*t = t1;
+}
+
+/* Fills in the record of the trial of the received word r, with errs errors
+ * of which neras are flagged, and the error pattern if a->tpos is set */
+static void trace_channel(struct thread_args *a, const uint16_t *c,
+			  const uint16_t *r, int errs, int neras,
+			  struct trace_rec *rec)
+{
+	const struct pc *pc = a->pc;
+	const uint8_t *eras = a->ws->eras;
+	size_t r_nroots = pc->row_code->nroots;
+	size_t c_nroots = pc->col_code->nroots;
+	size_t len = pc_len(pc);
+	unsigned row_w[pc->rows], col_w[pc->cols];
+	unsigned row_n[pc->rows], col_n[pc->cols];
+	size_t npos = 0;
+
+	memset(row_w, 0, sizeof(row_w));
+	memset(col_w, 0, sizeof(col_w));
+	memset(row_n, 0, sizeof(row_n));
+	memset(col_n, 0, sizeof(col_n));
+	*rec = (struct trace_rec) { .neras = neras };
+
+	/* An erasure costs half of what an error does */
+	for (size_t i = 0; i < len && npos < (size_t) errs; i++) {
+		if (r[i] == c[i])
+			continue;
+
+		size_t row = i / pc->cols, col = i % pc->cols;
+		unsigned w = eras && eras[i / 8] & 1 << (i % 8) ? 1 : 2;
+
+		row_w[row] += w;
+		col_w[col] += w;
+		row_n[row]++;
+		col_n[col]++;
+		if (a->tpos) {
+			a->tpos[npos] = i;
+			a->tval[npos] = r[i] ^ c[i];
+		}
+		npos++;
+	}
+	rec->errs = npos;
+
+	for (size_t i = 0; i < pc->rows; i++) {
+		if (row_n[i] > rec->row_max)
+			rec->row_max = row_n[i];
+		rec->rows_over += row_w[i] > r_nroots;
+	}
+	for (size_t i = 0; i < pc->cols; i++) {
+		if (col_n[i] > rec->col_max)
+			rec->col_max = col_n[i];
+		rec->cols_over += col_w[i] > c_nroots;
+	}
+}
+
+/* Fills in the decoding part of rec from the stats before and after it */
+static void trace_decode(const struct stats *s0, const struct stats *s,
+			 int derrs, int wrong, struct trace_rec *rec)
+{
+	rec->rdec = s->rdec - s0->rdec;
+	rec->cdec = s->cdec - s0->cdec;
+	rec->viable = s->viable - s0->viable;
+	rec->rounds = s->rounds - s0->rounds;
+	rec->stage = s->alg3 != s0->alg3 ? 2 : s->alg2 != s0->alg2;
+	rec->outcome = (wrong ? TRACE_WRONG : 0) |
+		       (derrs < 0 ? TRACE_REPORTED : 0);
 }
 
 /* Test up to error correction capacity */
@@ -126,25 +294,139 @@ static int test_normal(struct thread_args *args, _Atomic size_t *ecount)
 	uint16_t *c = ws->c;
 	uint16_t *r = ws->r;
 	int len = pc_len(pc);
-	int t = (pc_mind(pc) - 1) / 2;
+	int d = pc_mind(pc);
+	struct trace_buf *tb = NULL;
+	struct trace_rec rec;
+	struct stats s0;
 
 	memset(s, 0, sizeof(*s));
+	if (args->counters)
+		perf_counters_open(&args->pf);
+	if (args->trace)
+		tb = trace_buf_get(args->trace, args->p);
 
 	size_t j;
+	double t = args->timing ? now() : 0;
 	for (j = 0; j < trials || *ecount < min_errs; j++) {
-		int errs = get_rcw_channel(pc, c, r, args->p, args->rng);
+		int errs, neras = 0;
+
+		gen_random_msg(pc, c, args->rng);
+		phase_end(args, PHASE_MSG, &t);
+		pc_encode(pc, c);
+		phase_end(args, PHASE_ENCODE, &t);
+
+		if (ws->eras)
+			errs = add_channel_errors_eras(pc, c, r, args->p,
+						       args->p_eras, ws->eras,
+						       &neras, args->rng);
+		else
+			errs = add_channel_errors(pc, c, r, args->p,
+						  args->rng);
+		if (tb) {
+			trace_channel(args, c, r, errs, neras, &rec);
+			s0 = *s;
+		}
+		phase_end(args, PHASE_CHANNEL, &t);
+
+		if (args->counters)
+			perf_counters_start(&args->pf);
 		int derrs = args->decode(pc, r, s);
+		if (args->counters)
+			perf_counters_stop(&args->pf);
+		phase_end(args, PHASE_DECODE, &t);
 
 		if (derrs < 0)
 			s->rfail++;
 
-		if (memcmp(r, c, len * sizeof(*r))) {
+		/* An erasure costs half of what an error does */
+		int wrong = memcmp(r, c, len * sizeof(*r)) != 0;
+		if (wrong) {
 			(*ecount)++;
-			if (errs <= t)
+			if (2 * (errs - neras) + neras < d)
 				s->cfail++;
 		}
+		if (tb) {
+			trace_decode(&s0, s, derrs, wrong, &rec);
+			tb = trace_add(args->trace, tb, &rec, args->tpos,
+				       args->tval);
+		}
+		phase_end(args, PHASE_CHECK, &t);
 	}
 
+	if (args->counters)
+		perf_counters_close(&args->pf);
+	if (tb)
+		trace_submit(args->trace, tb);
+
+	s->nwords = j;
+	return s->cfail;
+}
+
+/* Like test_normal, but decodes the words width at a time with the batch
+ * version of the algorithm */
+static int test_batch(struct thread_args *args, _Atomic size_t *ecount)
+{
+	size_t min_errs = args->min_errs;
+	size_t trials = args->trials;
+	size_t width = args->width;
+	struct stats *s = &args->s;
+	struct pc *pc = args->pc;
+	struct wspace *ws = args->ws;
+	size_t len = pc_len(pc);
+	int tc = (pc_mind(pc) - 1) / 2;
+	int errs[width], ret[width];
+
+	memset(s, 0, sizeof(*s));
+	if (args->counters)
+		perf_counters_open(&args->pf);
+
+	size_t j;
+	double t = args->timing ? now() : 0;
+	for (j = 0; j < trials || *ecount < min_errs; j += width) {
+		for (size_t w = 0; w < width; w++) {
+			uint16_t *c = ws->c + w * len;
+			uint16_t *r = ws->r + w * len;
+
+			gen_random_msg(pc, c, args->rng);
+			phase_end(args, PHASE_MSG, &t);
+			pc_encode(pc, c);
+			phase_end(args, PHASE_ENCODE, &t);
+
+			errs[w] = add_channel_errors(pc, c, r, args->p,
+						     args->rng);
+			for (size_t i = 0; i < len; i++)
+				ws->b[i * width + w] = r[i];
+			phase_end(args, PHASE_CHANNEL, &t);
+		}
+
+		if (args->counters)
+			perf_counters_start(&args->pf);
+		args->decode_batch(args->batch, ws->b, ret, s);
+		if (args->counters)
+			perf_counters_stop(&args->pf);
+		phase_end(args, PHASE_DECODE, &t);
+
+		for (size_t w = 0; w < width; w++) {
+			const uint16_t *c = ws->c + w * len;
+
+			if (ret[w] < 0)
+				s->rfail++;
+
+			for (size_t i = 0; i < len; i++) {
+				if (ws->b[i * width + w] != c[i]) {
+					(*ecount)++;
+					if (errs[w] <= tc)
+						s->cfail++;
+					break;
+				}
+			}
+		}
+		phase_end(args, PHASE_CHECK, &t);
+	}
+
+	if (args->counters)
+		perf_counters_close(&args->pf);
+
 	s->nwords = j;
 	return s->cfail;
 }
@@ -152,15 +434,18 @@ static int test_normal(struct thread_args *args, _Atomic size_t *ecount)
 static void free_stuff(struct thread_args *args, int nthreads)
 {
 	for (int i = 0; i < nthreads; i++) {
+		pc_batch_free(args[i].batch);
 		pc_free(args[i].pc);
 		free_ws(args[i].ws);
 		gsl_rng_free(args[i].rng);
+		free(args[i].tpos);
+		free(args[i].tval);
 	}
 }
 
-static int alloc_stuff(struct thread_args *args, struct options *opt)
+static int alloc_stuff(struct thread_args *args, size_t nthreads,
+		       int pc_threads, struct options *opt)
 {
-	size_t nthreads = opt->nthreads;
 	memset(args, 0, nthreads * sizeof(*args));
 
 	for (size_t i = 0; i < nthreads; i++) {
@@ -171,11 +456,38 @@ static int alloc_stuff(struct thread_args *args, struct options *opt)
 		if (!args[i].pc)
 			goto err;
 
-		int len = pc_len(args[i].pc);
-		args[i].ws = alloc_ws(len * len);
+		if (pc_set_threads(args[i].pc, pc_threads))
+			goto err;
+
+		args[i].width = opt->batch > 1 ? opt->batch : 1;
+		if (args[i].width > 1) {
+			args[i].decode_batch = algorithm_get_batch(opt->alg);
+			args[i].batch = pc_batch_init(args[i].pc,
+						      args[i].width);
+			if (!args[i].batch)
+				goto err;
+		}
+
+		args[i].ws = alloc_ws(pc_len(args[i].pc), args[i].width,
+				      opt->p_eras > 0);
 		if (!args[i].ws)
 			goto err;
 
+		if (pc_set_erasures(args[i].pc, args[i].ws->eras))
+			goto err;
+		args[i].p_eras = opt->p_eras;
+		args[i].timing = opt->timing;
+		args[i].counters = opt->counters;
+
+		if (opt->trace_errors) {
+			size_t len = pc_len(args[i].pc);
+
+			args[i].tpos = malloc(len * sizeof(*args[i].tpos));
+			args[i].tval = malloc(len * sizeof(*args[i].tval));
+			if (!args[i].tpos || !args[i].tval)
+				goto err;
+		}
+
 		args[i].rng = rng_alloc_and_seed(opt->rng_type, opt->seed + i);
 		if (!args[i].rng)
 			goto err;
@@ -190,49 +502,133 @@ err:
 	return -1;
 }
 
-static void consolidate_stats(struct thread_args *args, int nthreads, size_t ecount)
+static void consolidate_stats(struct thread_args *args, int nthreads,
+			      size_t ecount, double wall)
 {
+	double t[NPHASES] = { 0 };
+
 	for (int i = 1; i < nthreads; i++)
 		stats_add(&args[0].s, &args[i].s);
 
 	print_stats(stdout, &args[0].s, args[0].p, ecount);
+	if (args[0].timing) {
+		for (int i = 0; i < nthreads; i++)
+			for (int ph = 0; ph < NPHASES; ph++)
+				t[ph] += args[i].t[ph];
+
+		print_timing(stdout, args[0].pc, t, args[0].s.nwords, wall);
+	}
+
+	if (args[0].counters) {
+		for (int i = 1; i < nthreads; i++)
+			perf_counters_add(&args[0].pf, &args[i].pf);
+
+		perf_counters_print(stdout, &args[0].pf, args[0].s.nwords);
+	}
+
+	fputc('\n', stdout);
+	fflush(stdout);
 }
 
 static int test_mt(struct thread_args *args, size_t nthreads, double p,
 		   size_t trials, size_t min_errs, double fer_cutoff)
 {
 	_Atomic size_t ecount = 0;
+	double wall = now();
 
-	#pragma omp parallel for
+	/* With a single worker the region is inactive, which leaves the team
+	 * to the decoder */
+	#pragma omp parallel for num_threads(nthreads)
 	for (size_t i = 0; i < nthreads; i++) {
 		args[i].p = p;
 		args[i].trials = trials;
 		args[i].min_errs = min_errs;
-		test_normal(args + i, &ecount);
+		memset(args[i].t, 0, sizeof(args[i].t));
+		if (args[i].batch)
+			test_batch(args + i, &ecount);
+		else
+			test_normal(args + i, &ecount);
 	}
 
-	consolidate_stats(args, nthreads, ecount);
+	consolidate_stats(args, nthreads, ecount, now() - wall);
 	if (((double) ecount) / args[0].s.nwords < fer_cutoff)
 		return -1;
 
 	return 0;
 }
 
+/*
+ * Small codewords are decoded one per thread. Large codewords are decoded one
+ * at a time by all threads, both because that is faster once a codeword no
+ * longer fits in the cache of one core, and because there may not be enough
+ * codewords to keep every thread busy.
+ */
+static int use_pc_threads(struct options *opt)
+{
+	return opt->nthreads > 1 &&
+	       (opt->rows * opt->cols >= PC_PAR_MIN_LEN ||
+		opt->cword_num < opt->nthreads);
+}
+
+/* Opens the trace of the trials, with two buffers for each worker so that
+ * one can be filled while the other is written */
+static struct trace *open_trace(const struct options *opt,
+				const struct pc *pc, size_t nworkers)
+{
+	struct trace_header h = {
+		.magic = TRACE_MAGIC,
+		.version = TRACE_VERSION,
+		.bom = TRACE_BOM,
+		.symsize = opt->symsize,
+		.rows = pc->rows,
+		.cols = pc->cols,
+		.r_nroots = pc->row_code->nroots,
+		.c_nroots = pc->col_code->nroots,
+		.flags = opt->trace_errors ? TRACE_ERRORS : 0,
+		.seed = opt->seed,
+		.p_eras = opt->p_eras,
+	};
+
+	strncpy(h.alg, algorithm_get_name(opt->alg), sizeof(h.alg) - 1);
+	return trace_open(opt->trace_file, &h, 2 * nworkers);
+}
+
 int run_simulation(struct options *opt)
 {
-	struct thread_args args[opt->nthreads];
+	size_t nworkers = opt->nthreads;
+	int pc_threads = 1;
+
+	if (use_pc_threads(opt)) {
+		nworkers = 1;
+		pc_threads = opt->nthreads;
+	}
+
+	struct thread_args args[nworkers];
 
-	int ret = alloc_stuff(args, opt);
+	int ret = alloc_stuff(args, nworkers, pc_threads, opt);
 	if (ret)
 		return -1;
 
-	size_t trials = opt->cword_num / opt->nthreads;
-	print_start(stdout, args[0].pc, "# ", opt->seed,
-		    opt->nthreads, algorithm_get_name(opt->alg));
+	struct trace *trace = NULL;
+	if (opt->trace_file) {
+		trace = open_trace(opt, args[0].pc, nworkers);
+		if (!trace) {
+			free_stuff(args, nworkers);
+			return -1;
+		}
+
+		for (size_t i = 0; i < nworkers; i++)
+			args[i].trace = trace;
+	}
+
+	size_t trials = opt->cword_num / nworkers;
+	print_start(stdout, args[0].pc, "# ", opt->seed, opt->nthreads,
+		    args[0].width, opt->p_eras, opt->timing, opt->counters,
+		    algorithm_get_name(opt->alg));
 
 	omp_set_num_threads(opt->nthreads);
 	for (double p = opt->p_start; p >= opt->p_stop - 10E-10; p -= opt->p_step) {
-		if (test_mt(args, opt->nthreads, p, trials,
+		if (test_mt(args, nworkers, p, trials,
 			    opt->min_errs, opt->fer_cutoff))
 			break;
 
@@ -242,6 +638,9 @@ int run_simulation(struct options *opt)
 		}
 	}
 
-	free_stuff(args, opt->nthreads);
+	free_stuff(args, nworkers);
+	if (trace && trace_close(trace))
+		return -1;
+
 	return 0;
 }
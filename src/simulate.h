@@ -31,12 +31,18 @@ struct options {
 	size_t cword_num;
 	size_t min_errs;
 	size_t nthreads;
+	size_t batch;
 	unsigned long seed;
 	double fer_cutoff;
 	double p_start;
 	double p_stop;
 	double p_step;
 	double p_halve_at;
+	double p_eras;		/* of a symbol in error being flagged */
+	int timing;		/* time the phases of the trials */
+	int counters;		/* read the hardware counters */
+	const char *trace_file;	/* of the trials, or NULL */
+	int trace_errors;	/* with the error patterns */
 	size_t rows;
 	size_t cols;
 	size_t symsize;
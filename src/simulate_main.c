@@ -41,7 +41,8 @@ static int print_help(FILE *file)
 	static const char *helpstr =
 "Run simulation with product codes. The component codes are Reed-Solomon\n"
 "codes over fields of size 2^m and the channel is a q-ary symmetric\n"
-"channel. Outputs to stdout\n\n"
+"channel, which may flag some of the symbols in error as erased. Outputs to\n"
+"stdout\n\n"
 "Mandatory arguments to long options are mandatory for short options too.\n"
 "  -a, --algorithm=ALG		The decoding algorithm to use. To see a list of all\n"
 "                                 available algorithms give 'list' as argument.\n"
@@ -53,6 +54,15 @@ static int print_help(FILE *file)
 "      --r-nroots=NUM           The number of roots in the row code. The\n"
 "                                 minimum distance of the row code is\n"
 "                                 NUM + 1.\n"
+"      --counters               Read the hardware counters of the decoding\n"
+"                                 threads and add the cycles, instructions,\n"
+"                                 cache misses and branch misses per codeword\n"
+"                                 as columns. Counters that cannot be read,\n"
+"                                 such as in many containers, are nan.\n"
+"      --erasures=VAL           The probability that the channel flags a symbol\n"
+"                                 in error as erased, and passes the erasure\n"
+"                                 to the decoder. The default is 0. Not for\n"
+"                                 batches.\n"
 "  -f, --fer-cutoff=VAL         The frame error rate cutoff. Set to zero\n"
 "                                 disable.\n"
 "  -g, --gfpoly=POLY            The Galois Field polynomial to use. If POLY is zero,\n"
@@ -69,7 +79,23 @@ static int print_help(FILE *file)
 "                                 available generators give 'list' as argument.\n"
 "  -s, --sym-size=NUM           The symbol size in bits.\n"
 "  -S, --seed=SEED              The seed for the random number generator.\n"
-"  -T, --threads=NUM            Number of computational threads to use.\n"
+"      --timing                 Time the phases of the trials and add the\n"
+"                                 seconds spent in each, summed over the\n"
+"                                 threads, the codewords decoded per second\n"
+"                                 and the message bits decoded per second of\n"
+"                                 decoding per core as columns.\n"
+"      --trace=FILE             Write a record of every trial to FILE, for\n"
+"                                 offline analysis with pctrace. The records\n"
+"                                 have the number of errors, how they fall\n"
+"                                 on the rows and columns, the decoder calls,\n"
+"                                 rounds and stage of the decoding and its\n"
+"                                 outcome. Not for batches.\n"
+"      --trace-errors           Add the error patterns to the trace.\n"
+"  -T, --threads=NUM            Number of computational threads to use. Large\n"
+"                                 codes are decoded one word at a time by all\n"
+"                                 threads, smaller ones one word per thread.\n"
+"  -w, --batch=NUM              Decode NUM words at a time in lockstep. Only\n"
+"                                 for the algorithms iter and eras.\n"
 "      --help                   Display this help and exit.\n"
 "      --version                Output version information and exit.\n";
 
@@ -79,14 +105,20 @@ static int print_help(FILE *file)
 
 static void parse_cmdline(int argc, char *const argv[], struct options *opt)
 {
-	static const char *optstring = "a:g:n:c:r:R:S:s:b:e:t:h:E:f:T:";
+	static const char *optstring = "a:g:n:c:r:R:S:s:b:e:t:h:E:f:T:w:";
 	static struct option longopt[] = {
 		{ "algorithm",	required_argument, NULL, 'a' },
 		{ "gfpoly",	required_argument, NULL, 'g' },
 		{ "num-words",	required_argument, NULL, 'n' },
 		{ "min-errors", required_argument, NULL, 'E' },
 		{ "fer-cutoff", required_argument, NULL, 'f' },
+		{ "erasures",	required_argument, NULL, 'x' },
 		{ "threads",	required_argument, NULL, 'T' },
+		{ "timing",	no_argument,	   NULL, 'P' },
+		{ "counters",	no_argument,	   NULL, 'C' },
+		{ "trace",	required_argument, NULL, 'O' },
+		{ "trace-errors", no_argument,	   NULL, 'W' },
+		{ "batch",	required_argument, NULL, 'w' },
 		{ "cols",	required_argument, NULL, 'c' },
 		{ "rows",	required_argument, NULL, 'r' },
 		{ "r-nroots",	required_argument, NULL, 'U' },
@@ -106,7 +138,7 @@ static void parse_cmdline(int argc, char *const argv[], struct options *opt)
 	// Setting default options
 	*opt = (struct options) {
 		.alg = pc_decode_gmd,
-		.nthreads = 1,
+		.nthreads = 1, .batch = 1,
 		.symsize = 0, .gfpoly = 0,
 		.rows = 0, .cols = 0,
 		.r_nroots = 0, .c_nroots = 0,
@@ -165,6 +197,25 @@ static void parse_cmdline(int argc, char *const argv[], struct options *opt)
 			      && !(errno == ERANGE && opt->fer_cutoff == HUGE_VAL),
 			      "invalid argument to option '%c': '%s'", ch, optarg);
 			break;
+		case 'P':
+			opt->timing = 1;
+			break;
+		case 'C':
+			opt->counters = 1;
+			break;
+		case 'O':
+			opt->trace_file = optarg;
+			break;
+		case 'W':
+			opt->trace_errors = 1;
+			break;
+		case 'x':
+			opt->p_eras = strtod(optarg, &endptr);
+			check(*endptr == '\0' && opt->p_eras >= 0
+			      && opt->p_eras <= 1,
+			      "invalid argument to option '%s': '%s'",
+			      "erasures", optarg);
+			break;
 		case 'r':
 			opt->rows = strtoul(optarg, &endptr, 10);
 			check(*endptr == '\0'
@@ -237,6 +288,13 @@ static void parse_cmdline(int argc, char *const argv[], struct options *opt)
 			      && !(errno == ERANGE && opt->nthreads == ULONG_MAX),
 			      "invalid argument to option '%c': '%s'", ch, optarg);
 			break;
+		case 'w':
+			opt->batch = strtoul(optarg, &endptr, 10);
+			check(*endptr == '\0'
+			      && !(errno == ERANGE && opt->batch == ULONG_MAX)
+			      && opt->batch > 0,
+			      "invalid argument to option '%c': '%s'", ch, optarg);
+			break;
 		case 'H':
 			exit(print_help(stdout));
 		case 'V':
@@ -256,6 +314,15 @@ static void parse_cmdline(int argc, char *const argv[], struct options *opt)
 
 	// Checking that arguments are sane
 	check(opt->p_start >= opt->p_stop, "p-begin must be larger than p-end");
+	check(opt->batch == 1 || algorithm_get_batch(opt->alg),
+	      "algorithm '%s' cannot decode in batches",
+	      algorithm_get_name(opt->alg));
+	check(opt->batch == 1 || opt->p_eras == 0,
+	      "the batch decoders do not take erasures");
+	check(opt->batch == 1 || !opt->trace_file,
+	      "the trials of batches cannot be traced");
+	check(opt->trace_file || !opt->trace_errors,
+	      "option '%s' requires option '%s'", "trace-errors", "trace");
 
 	if (opt->gfpoly == 0)
 		opt->gfpoly = get_gfpoly(opt->symsize);
@@ -0,0 +1,375 @@
+/*
+ * trial_trace.c
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+#include "trial_trace.h"
+#include "dbg.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Records per buffer, and so at most per block */
+#define TRACE_BUF_RECS 4096
+
+#define COL(name, desc) { #name, desc, offsetof(struct trace_rec, name), \
+			  sizeof(((struct trace_rec *) 0)->name) }
+
+const struct trace_col trace_cols[] = {
+	COL(errs, "symbols in error"),
+	COL(neras, "symbols flagged as erased"),
+	COL(row_max, "most errors in a row"),
+	COL(rows_over, "rows beyond the correction capability"),
+	COL(col_max, "most errors in a column"),
+	COL(cols_over, "columns beyond the correction capability"),
+	COL(rdec, "row decoder calls"),
+	COL(cdec, "column decoder calls"),
+	COL(viable, "viable strategies"),
+	COL(rounds, "rounds"),
+	COL(stage, "decoder of the cascade that ended it, from 0"),
+	COL(outcome, "outcome, 1 if wrong plus 2 if reported"),
+};
+
+const size_t trace_ncols = sizeof(trace_cols) / sizeof(trace_cols[0]);
+
+struct trace_buf {
+	struct trace_buf *next;
+	double p;
+	size_t n;
+	size_t npos;
+	size_t pos_alloc;
+	uint32_t *pos;
+	uint16_t *val;
+	struct trace_rec recs[TRACE_BUF_RECS];
+};
+
+struct trace {
+	FILE *file;
+	uint32_t flags;
+	size_t nbufs;
+	struct trace_buf *bufs;
+	struct trace_buf *free;			/* to be taken */
+	struct trace_buf *full, **full_tail;	/* to be written, in order */
+	int stop;
+	int error;
+	unsigned char col[TRACE_BUF_RECS * sizeof(uint32_t)];
+
+	pthread_t writer;
+	pthread_mutex_t lock;
+	pthread_cond_t filled;	/* a buffer to write, or stop */
+	pthread_cond_t freed;	/* a buffer is free */
+};
+
+/* Writes the records of b as a block. Only the writer thread calls this. */
+static int write_block(struct trace *t, const struct trace_buf *b)
+{
+	struct trace_block hdr = {
+		.magic = TRACE_BLOCK_MAGIC,
+		.n = b->n,
+		.npos = b->npos,
+		.p = b->p
+	};
+
+	if (fwrite(&hdr, sizeof(hdr), 1, t->file) != 1)
+		return -1;
+
+	for (size_t c = 0; c < trace_ncols; c++) {
+		size_t size = trace_cols[c].size;
+
+		for (size_t i = 0; i < b->n; i++)
+			memcpy(t->col + i * size, (const unsigned char *)
+			       &b->recs[i] + trace_cols[c].off, size);
+
+		if (fwrite(t->col, size, b->n, t->file) != b->n)
+			return -1;
+	}
+
+	if (t->flags & TRACE_ERRORS &&
+	    (fwrite(b->pos, sizeof(*b->pos), b->npos, t->file) != b->npos ||
+	     fwrite(b->val, sizeof(*b->val), b->npos, t->file) != b->npos))
+		return -1;
+
+	return 0;
+}
+
+static void *writer(void *arg)
+{
+	struct trace *t = arg;
+
+	pthread_mutex_lock(&t->lock);
+	for (;;) {
+		while (!t->full && !t->stop)
+			pthread_cond_wait(&t->filled, &t->lock);
+
+		struct trace_buf *b = t->full;
+		if (!b)
+			break;
+
+		t->full = b->next;
+		if (!t->full)
+			t->full_tail = &t->full;
+		int failed = t->error;
+		pthread_mutex_unlock(&t->lock);
+
+		int err = b->n && !failed && write_block(t, b);
+
+		pthread_mutex_lock(&t->lock);
+		if (err) {
+			log_err("cannot write the trace");
+			t->error = 1;
+		}
+		b->next = t->free;
+		t->free = b;
+		pthread_cond_signal(&t->freed);
+	}
+	pthread_mutex_unlock(&t->lock);
+
+	return NULL;
+}
+
+static void free_bufs(struct trace *t)
+{
+	for (size_t i = 0; t->bufs && i < t->nbufs; i++) {
+		free(t->bufs[i].pos);
+		free(t->bufs[i].val);
+	}
+	free(t->bufs);
+}
+
+struct trace *trace_open(const char *path, const struct trace_header *h,
+			 size_t nbufs)
+{
+	struct trace *t = calloc(1, sizeof(*t));
+	check_mem(t);
+
+	t->flags = h->flags;
+	t->full_tail = &t->full;
+	t->nbufs = nbufs;
+	t->bufs = calloc(nbufs, sizeof(*t->bufs));
+	check_mem(t->bufs);
+	for (size_t i = 0; i < nbufs; i++) {
+		t->bufs[i].next = t->free;
+		t->free = &t->bufs[i];
+	}
+
+	t->file = fopen(path, "wb");
+	check(t->file, "cannot open '%s'", path);
+	check(fwrite(h, sizeof(*h), 1, t->file) == 1,
+	      "cannot write '%s'", path);
+
+	pthread_mutex_init(&t->lock, NULL);
+	pthread_cond_init(&t->filled, NULL);
+	pthread_cond_init(&t->freed, NULL);
+	lcheck_pf(!pthread_create(&t->writer, NULL, writer, t), log_err_ne,
+		  error, "cannot start the trace writer");
+
+	return t;
+
+error:
+	if (t) {
+		if (t->file)
+			fclose(t->file);
+		free_bufs(t);
+		free(t);
+	}
+	return NULL;
+}
+
+struct trace_buf *trace_buf_get(struct trace *t, double p)
+{
+	pthread_mutex_lock(&t->lock);
+	while (!t->free)
+		pthread_cond_wait(&t->freed, &t->lock);
+
+	struct trace_buf *b = t->free;
+	t->free = b->next;
+	pthread_mutex_unlock(&t->lock);
+
+	b->p = p;
+	b->n = 0;
+	b->npos = 0;
+	return b;
+}
+
+void trace_submit(struct trace *t, struct trace_buf *b)
+{
+	pthread_mutex_lock(&t->lock);
+	b->next = NULL;
+	*t->full_tail = b;
+	t->full_tail = &b->next;
+	pthread_cond_signal(&t->filled);
+	pthread_mutex_unlock(&t->lock);
+}
+
+struct trace_buf *trace_add(struct trace *t, struct trace_buf *b,
+			    const struct trace_rec *r, const uint32_t *pos,
+			    const uint16_t *val)
+{
+	size_t errs = t->flags & TRACE_ERRORS ? r->errs : 0;
+
+	if (b->n == TRACE_BUF_RECS ||
+	    (b->n && b->npos + errs > b->pos_alloc)) {
+		double p = b->p;
+
+		trace_submit(t, b);
+		b = trace_buf_get(t, p);
+	}
+
+	if (b->npos + errs > b->pos_alloc) {
+		size_t alloc = 2 * b->pos_alloc > errs ? 2 * b->pos_alloc
+						       : errs;
+		uint32_t *p = realloc(b->pos, alloc * sizeof(*p));
+		if (p)
+			b->pos = p;
+		uint16_t *v = realloc(b->val, alloc * sizeof(*v));
+		if (v)
+			b->val = v;
+
+		if (!p || !v) {
+			log_err("Memory allocation error.");
+			pthread_mutex_lock(&t->lock);
+			t->error = 1;
+			pthread_mutex_unlock(&t->lock);
+			return b;
+		}
+		b->pos_alloc = alloc;
+	}
+
+	b->recs[b->n++] = *r;
+	memcpy(b->pos + b->npos, pos, errs * sizeof(*pos));
+	memcpy(b->val + b->npos, val, errs * sizeof(*val));
+	b->npos += errs;
+	return b;
+}
+
+int trace_close(struct trace *t)
+{
+	pthread_mutex_lock(&t->lock);
+	t->stop = 1;
+	pthread_cond_signal(&t->filled);
+	pthread_mutex_unlock(&t->lock);
+	pthread_join(t->writer, NULL);
+
+	int ret = t->error ? -1 : 0;
+	if (fclose(t->file)) {
+		log_err("cannot write the trace");
+		ret = -1;
+	}
+
+	pthread_cond_destroy(&t->freed);
+	pthread_cond_destroy(&t->filled);
+	pthread_mutex_destroy(&t->lock);
+	free_bufs(t);
+	free(t);
+	return ret;
+}
+
+int trace_read_header(FILE *file, struct trace_header *h)
+{
+	lcheck_pf(fread(h, sizeof(*h), 1, file) == 1 &&
+		  !memcmp(h->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)),
+		  log_err_ne, error, "not a trace");
+	lcheck_pf(h->bom == TRACE_BOM, log_err_ne, error,
+		  "the trace is in another byte order");
+	lcheck_pf(h->version == TRACE_VERSION, log_err_ne, error,
+		  "unknown trace version %u", (unsigned) h->version);
+	return 0;
+
+error:
+	return -1;
+}
+
+/* Makes room for n records and npos errors in d */
+static int reserve(struct trace_data *d, size_t n, size_t npos)
+{
+	if (n > d->rec_alloc) {
+		struct trace_rec *recs = realloc(d->recs, n * sizeof(*recs));
+		if (!recs)
+			return -1;
+
+		d->recs = recs;
+		d->rec_alloc = n;
+	}
+
+	if (npos > d->pos_alloc) {
+		uint32_t *pos = realloc(d->pos, npos * sizeof(*pos));
+		if (!pos)
+			return -1;
+		d->pos = pos;
+
+		uint16_t *val = realloc(d->val, npos * sizeof(*val));
+		if (!val)
+			return -1;
+		d->val = val;
+
+		d->pos_alloc = npos;
+	}
+
+	return 0;
+}
+
+int trace_read_block(FILE *file, const struct trace_header *h,
+		     struct trace_data *d)
+{
+	struct trace_block *hdr = &d->hdr;
+	unsigned char col[TRACE_BUF_RECS * sizeof(uint32_t)];
+
+	size_t n = fread(hdr, 1, sizeof(*hdr), file);
+	if (n == 0 && feof(file))
+		return 0;
+
+	lcheck_pf(n == sizeof(*hdr) && hdr->magic == TRACE_BLOCK_MAGIC &&
+		  hdr->n <= TRACE_BUF_RECS, log_err_ne, error,
+		  "corrupt trace block");
+	check_mem(!reserve(d, hdr->n, hdr->npos));
+
+	memset(d->recs, 0, hdr->n * sizeof(*d->recs));
+	for (size_t c = 0; c < trace_ncols; c++) {
+		size_t size = trace_cols[c].size;
+
+		lcheck_pf(fread(col, size, hdr->n, file) == hdr->n,
+			  log_err_ne, error, "truncated trace block");
+		for (size_t i = 0; i < hdr->n; i++)
+			memcpy((unsigned char *) &d->recs[i] +
+			       trace_cols[c].off, col + i * size, size);
+	}
+
+	if (!(h->flags & TRACE_ERRORS))
+		return 1;
+
+	size_t npos = 0;
+	for (size_t i = 0; i < hdr->n; i++)
+		npos += d->recs[i].errs;
+
+	lcheck_pf(npos == hdr->npos, log_err_ne, error, "corrupt trace block");
+	lcheck_pf(fread(d->pos, sizeof(*d->pos), npos, file) == npos &&
+		  fread(d->val, sizeof(*d->val), npos, file) == npos,
+		  log_err_ne, error, "truncated trace block");
+	return 1;
+
+error:
+	return -1;
+}
+
+void trace_data_free(struct trace_data *d)
+{
+	free(d->recs);
+	free(d->pos);
+	free(d->val);
+}
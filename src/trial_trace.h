@@ -0,0 +1,173 @@
+/*
+ * trial_trace.h
+ * Copyright (C) 2019 Ferdinand Blomqvist
+ *
+ * This file is part of pcdecode.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Written by Ferdinand Blomqvist.
+ */
+
+
+#ifndef FB_PCDECODE_TRIAL_TRACE_H
+#define FB_PCDECODE_TRIAL_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Traces of the trials of simulate, one record per decoded word. The file is
+ * a trace_header followed by blocks. A block is a trace_block header and then
+ * its records column by column, each column n values of the width given in
+ * trace_cols, and, if the trace has TRACE_ERRORS, the positions of the errors
+ * of all the records, as npos uint32_t, followed by their values, as npos
+ * uint16_t. The errors of a record are errs consecutive entries. Everything
+ * is in the byte order of the machine that wrote it.
+ *
+ * All records of a block have the same channel error probability p. The
+ * blocks of the threads are interleaved, so the records of a p are in no
+ * particular order.
+ */
+#define TRACE_MAGIC "PCTRACE"
+#define TRACE_VERSION 1
+#define TRACE_BOM 0x01020304U
+#define TRACE_BLOCK_MAGIC 0x42544350U	/* "PCTB" */
+
+/* The error patterns are included */
+#define TRACE_ERRORS 1U
+
+struct trace_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t bom;
+	uint32_t symsize;
+	uint32_t rows;
+	uint32_t cols;
+	uint32_t r_nroots;
+	uint32_t c_nroots;
+	uint32_t flags;
+	uint64_t seed;
+	double p_eras;
+	char alg[16];
+};
+
+struct trace_block {
+	uint32_t magic;
+	uint32_t n;		/* records */
+	uint32_t npos;		/* errors, with TRACE_ERRORS */
+	uint32_t reserved;
+	double p;
+};
+
+/* The bits of outcome */
+#define TRACE_WRONG 1U		/* the word decoded is not the one sent */
+#define TRACE_REPORTED 2U	/* the decoder reported a failure */
+
+struct trace_rec {
+	uint32_t errs;		/* symbols in error, erasures included */
+	uint32_t neras;		/* of them flagged as erased */
+	uint16_t row_max;	/* most errors in a row */
+	uint16_t rows_over;	/* rows with more errors than they correct */
+	uint16_t col_max;
+	uint16_t cols_over;
+	uint32_t rdec;		/* row decoder calls */
+	uint32_t cdec;		/* column decoder calls */
+	uint32_t viable;	/* viable erasure strategies of gmd and gd */
+	uint16_t rounds;	/* of iter and eras */
+	uint8_t stage;		/* stage of the cascade that ended it, from 0 */
+	uint8_t outcome;
+};
+
+struct trace_col {
+	const char *name;
+	const char *desc;
+	size_t off;		/* in struct trace_rec */
+	size_t size;		/* bytes */
+};
+
+/* The columns of a block, in the order they are stored */
+extern const struct trace_col trace_cols[];
+extern const size_t trace_ncols;
+
+static inline uint32_t trace_rec_get(const struct trace_rec *r, size_t col)
+{
+	const unsigned char *p = (const unsigned char *) r + trace_cols[col].off;
+
+	switch (trace_cols[col].size) {
+	case 1:
+		return *p;
+	case 2:
+		return *(const uint16_t *) p;
+	default:
+		return *(const uint32_t *) p;
+	}
+}
+
+/*
+ * Writing. The records are collected in buffers that a writer thread writes
+ * to the file. Each thread that adds records takes a buffer of its own, so the
+ * threads only synchronize when a buffer is full.
+ */
+struct trace;
+struct trace_buf;
+
+/* Creates the trace file path with the header h and starts the writer, with
+ * nbufs buffers to share between the threads. Returns NULL on errors. */
+struct trace *trace_open(const char *path, const struct trace_header *h,
+			 size_t nbufs);
+
+/* Takes a buffer for records with channel error probability p. Waits while
+ * the writer has all of them. */
+struct trace_buf *trace_buf_get(struct trace *t, double p);
+
+/* Adds the record r, with the errors at pos of values val if the trace has
+ * TRACE_ERRORS, to b. Returns the buffer to add the next record to, which is a
+ * new one if b was full and has been passed to the writer. */
+struct trace_buf *trace_add(struct trace *t, struct trace_buf *b,
+			    const struct trace_rec *r, const uint32_t *pos,
+			    const uint16_t *val);
+
+/* Passes b to the writer */
+void trace_submit(struct trace *t, struct trace_buf *b);
+
+/* Writes what is left, stops the writer and closes the file. All buffers
+ * must have been submitted. Returns -1 if some write failed. */
+int trace_close(struct trace *t);
+
+/*
+ * Reading. A block read holds the records of one trace_block, and their
+ * errors. Its arrays are reused by the next read.
+ */
+struct trace_data {
+	struct trace_block hdr;
+	struct trace_rec *recs;
+	uint32_t *pos;
+	uint16_t *val;
+	size_t rec_alloc;
+	size_t pos_alloc;
+};
+
+/* Reads and checks the header. Returns -1 if file is not a trace this program
+ * can read. */
+int trace_read_header(FILE *file, struct trace_header *h);
+
+/* Reads the next block into d. Returns 1 on success, 0 at the end of the file
+ * and -1 on errors. */
+int trace_read_block(FILE *file, const struct trace_header *h,
+		     struct trace_data *d);
+
+void trace_data_free(struct trace_data *d);
+
+#endif /* FB_PCDECODE_TRIAL_TRACE_H */